@@ -1,6 +1,16 @@
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 #include "dnachar.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
 namespace TwoPaCo
 {
 	bool DnaChar::isValid_[CHAR_SIZE];
@@ -87,11 +97,7 @@ namespace TwoPaCo
 	std::string DnaChar::ReverseCompliment(const std::string & str)
 	{
 		std::string ret;
-		for (auto it = str.rbegin(); it != str.rend(); ++it)
-		{
-			ret.push_back(DnaChar::ReverseChar(*it));
-		}
-
+		ReverseCompliment(str.data(), str.data() + str.size(), ret);
 		return ret;
 	}
 
@@ -112,4 +118,101 @@ namespace TwoPaCo
 
 		return false;
 	}
-}
\ No newline at end of file
+
+	void DnaChar::Pack(const char * str, size_t size, uint64_t * out)
+	{
+		//Eight characters at once: the code sits in the bits 1 and 2 of each ASCII letter
+		const uint64_t CODE_MASK = 0x0303030303030303ULL;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t chunk;
+			memcpy(&chunk, str + i, sizeof(chunk));
+			uint64_t code = ((chunk >> 1) ^ (chunk >> 2)) & CODE_MASK;
+#ifdef __BMI2__
+			code = _pext_u64(code, CODE_MASK);
+#else
+			code = (code | (code >> 6)) & 0x000F000F000F000FULL;
+			code = (code | (code >> 12)) & 0x000000FF000000FFULL;
+			code = (code | (code >> 24)) & 0xFFFFULL;
+#endif
+			out[i >> 5] |= code << ((i & 31) << 1);
+		}
+
+		for (; i < size; i++)
+		{
+			out[i >> 5] |= Code(str[i]) << ((i & 31) << 1);
+		}
+	}
+
+	void DnaChar::ReverseComplementPacked(const uint64_t * in, size_t size, uint64_t * out)
+	{
+		//Reverse the words, then shift out the complemented padding of the last word
+		size_t words = (size + 31) >> 5;
+		size_t shift = ((words << 5) - size) << 1;
+		for (size_t i = 0; i < words; i++)
+		{
+			uint64_t now = ReverseComplementWord(in[words - i - 1]);
+			uint64_t next = i + 1 < words ? ReverseComplementWord(in[words - i - 2]) : 0;
+			out[i] |= shift == 0 ? now : (now >> shift) | (next << (64 - shift));
+		}
+	}
+
+	void DnaChar::NMask(const char * str, size_t size, uint64_t * mask)
+	{
+		size_t i = 0;
+		std::fill(mask, mask + ((size + 63) >> 6), 0);
+#ifdef __SSE2__
+		const __m128i a = _mm_set1_epi8('A');
+		const __m128i c = _mm_set1_epi8('C');
+		const __m128i g = _mm_set1_epi8('G');
+		const __m128i t = _mm_set1_epi8('T');
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i now = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+			__m128i definite = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(now, a), _mm_cmpeq_epi8(now, c)),
+				_mm_or_si128(_mm_cmpeq_epi8(now, g), _mm_cmpeq_epi8(now, t)));
+			uint64_t bits = ~uint64_t(_mm_movemask_epi8(definite)) & 0xFFFF;
+			mask[i >> 6] |= bits << (i & 63);
+		}
+#endif
+		for (; i < size; i++)
+		{
+			mask[i >> 6] |= uint64_t(isDefinite_[uint8_t(str[i])] ? 0 : 1) << (i & 63);
+		}
+	}
+
+	size_t DnaChar::CountDefinite(const char * str, size_t size)
+	{
+		size_t i = 0;
+		size_t ret = 0;
+#ifdef __SSE2__
+		const __m128i a = _mm_set1_epi8('A');
+		const __m128i c = _mm_set1_epi8('C');
+		const __m128i g = _mm_set1_epi8('G');
+		const __m128i t = _mm_set1_epi8('T');
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i now = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+			__m128i definite = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(now, a), _mm_cmpeq_epi8(now, c)),
+				_mm_or_si128(_mm_cmpeq_epi8(now, g), _mm_cmpeq_epi8(now, t)));
+			ret += __builtin_popcount(_mm_movemask_epi8(definite));
+		}
+#endif
+		for (; i < size; i++)
+		{
+			ret += isDefinite_[uint8_t(str[i])] ? 1 : 0;
+		}
+
+		return ret;
+	}
+
+	void DnaChar::ReverseCompliment(const char * begin, const char * end, std::string & out)
+	{
+		out.resize(end - begin);
+		for (std::string::iterator it = out.begin(); it != out.end(); ++it)
+		{
+			*it = reverseTable_[uint8_t(*--end)];
+		}
+	}
+}
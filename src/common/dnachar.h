@@ -21,6 +21,30 @@ namespace TwoPaCo
 		static size_t MakeUpChar(char ch);
 		static char UnMakeUpChar(size_t ch);
 		static bool LessSelfReverseComplement(std::string::const_iterator pit, size_t vertexSize);
+
+		//Kernels processing whole strings. A packed string keeps 32 characters per word,
+		//the i-th one in the bits 2i and 2i + 1 with the code given by MakeUpChar.
+		//Pack and ReverseComplementPacked add the characters to the zeroed output.
+		static void Pack(const char * str, size_t size, uint64_t * out);
+		static void ReverseComplementPacked(const uint64_t * in, size_t size, uint64_t * out);
+		static void NMask(const char * str, size_t size, uint64_t * mask);
+		static size_t CountDefinite(const char * str, size_t size);
+		static void ReverseCompliment(const char * begin, const char * end, std::string & out);
+
+		static uint64_t ReverseComplementWord(uint64_t word)
+		{
+			word = ~word;
+			word = ((word >> 2) & 0x3333333333333333ULL) | ((word & 0x3333333333333333ULL) << 2);
+			word = ((word >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((word & 0x0F0F0F0F0F0F0F0FULL) << 4);
+			return __builtin_bswap64(word);
+		}
+
+		//Code of a definite character computed without a branch, 'N' gives zero
+		static uint64_t Code(char ch)
+		{
+			return ((ch >> 1) ^ (ch >> 2)) & 3;
+		}
+
 	private:
 		static const size_t CHAR_SIZE = 1 << 8;
 		static bool isValid_[CHAR_SIZE];
@@ -0,0 +1,271 @@
+#ifndef _COMPACTED_GRAPH_H_
+#define _COMPACTED_GRAPH_H_
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace TwoPaCo
+{
+	//Layout of the binary compacted graph produced by "graphdump -f bin". The file
+	//starts with the header followed by the sections, each of them starts at a page
+	//boundary. Segments are numbered from 0, an oriented segment is 2 * segment for
+	//the direct strand and 2 * segment + 1 for the reverse complementary one.
+	struct CompactedGraphHeader
+	{
+		enum SectionId
+		{
+			//uint64_t[segments + 1], start of each segment in the packed sequence
+			SEGMENT_OFFSET,
+			//int64_t[segments], the segment ids used in GFA output
+			SEGMENT_NAME,
+			//Bases of all segments, 2 bits per base, 4 bases per byte starting from the lowest bits
+			SEGMENT_SEQUENCE,
+			//uint64_t[], sorted positions of N characters in the packed sequence
+			N_POSITION,
+			//uint64_t[2 * segments + 1], CSR offsets of links of oriented segments
+			LINK_OFFSET,
+			//uint64_t[links], oriented segments the links point to
+			LINK_TARGET,
+			//uint64_t[paths + 1], start of each path in the steps array
+			PATH_OFFSET,
+			//uint64_t[steps], oriented segments spelling the input sequences
+			PATH_STEP,
+			//uint64_t[paths + 1], start of each path name
+			PATH_NAME_OFFSET,
+			//Concatenated path names
+			PATH_NAME,
+			SECTIONS_COUNT
+		};
+
+		struct Section
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		static const uint64_t VERSION = 1;
+		static const uint64_t PAGE_SIZE = 4096;
+
+		char magic[8];
+		uint64_t version;
+		uint64_t k;
+		uint64_t segmentsCount;
+		uint64_t basesCount;
+		uint64_t nCount;
+		uint64_t linksCount;
+		uint64_t pathsCount;
+		uint64_t stepsCount;
+		Section section[SECTIONS_COUNT];
+
+		static const char * Magic()
+		{
+			return "TPCGRAPH";
+		}
+
+		static uint64_t Align(uint64_t offset)
+		{
+			return (offset + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+		}
+	};
+
+	//Read-only view of a binary compacted graph mapped into memory
+	class CompactedGraph
+	{
+	public:
+		CompactedGraph(const std::string & fileName) : size_(0), data_(0)
+		{
+			int fd = open(fileName.c_str(), O_RDONLY);
+			if (fd == -1)
+			{
+				throw std::runtime_error("Can't open the graph file");
+			}
+
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size >= 0 && uint64_t(st.st_size) >= sizeof(CompactedGraphHeader))
+			{
+				size_ = st.st_size;
+				void * data = mmap(0, size_, PROT_READ, MAP_SHARED, fd, 0);
+				data_ = data == MAP_FAILED ? 0 : static_cast<const char*>(data);
+			}
+
+			close(fd);
+			if (data_ == 0)
+			{
+				throw std::runtime_error("Can't map the graph file");
+			}
+
+			header_ = reinterpret_cast<const CompactedGraphHeader*>(data_);
+			if (memcmp(header_->magic, CompactedGraphHeader::Magic(), sizeof(header_->magic)) != 0 || header_->version != CompactedGraphHeader::VERSION)
+			{
+				munmap(const_cast<char*>(data_), size_);
+				throw std::runtime_error("The graph file is corrupted or has an unsupported version");
+			}
+
+			for (size_t i = 0; i < CompactedGraphHeader::SECTIONS_COUNT; i++)
+			{
+				if (header_->section[i].offset + header_->section[i].size > size_)
+				{
+					munmap(const_cast<char*>(data_), size_);
+					throw std::runtime_error("The graph file is truncated");
+				}
+			}
+
+			segmentOffset_ = Section<uint64_t>(CompactedGraphHeader::SEGMENT_OFFSET);
+			segmentName_ = Section<int64_t>(CompactedGraphHeader::SEGMENT_NAME);
+			sequence_ = Section<uint8_t>(CompactedGraphHeader::SEGMENT_SEQUENCE);
+			nPosition_ = Section<uint64_t>(CompactedGraphHeader::N_POSITION);
+			linkOffset_ = Section<uint64_t>(CompactedGraphHeader::LINK_OFFSET);
+			linkTarget_ = Section<uint64_t>(CompactedGraphHeader::LINK_TARGET);
+			pathOffset_ = Section<uint64_t>(CompactedGraphHeader::PATH_OFFSET);
+			pathStep_ = Section<uint64_t>(CompactedGraphHeader::PATH_STEP);
+			pathNameOffset_ = Section<uint64_t>(CompactedGraphHeader::PATH_NAME_OFFSET);
+			pathName_ = Section<char>(CompactedGraphHeader::PATH_NAME);
+		}
+
+		~CompactedGraph()
+		{
+			munmap(const_cast<char*>(data_), size_);
+		}
+
+		static uint64_t Oriented(uint64_t segment, bool positive)
+		{
+			return segment * 2 + (positive ? 0 : 1);
+		}
+
+		static uint64_t Segment(uint64_t oriented)
+		{
+			return oriented >> 1;
+		}
+
+		static bool IsPositive(uint64_t oriented)
+		{
+			return (oriented & 1) == 0;
+		}
+
+		static uint64_t Flip(uint64_t oriented)
+		{
+			return oriented ^ 1;
+		}
+
+		uint64_t GetK() const
+		{
+			return header_->k;
+		}
+
+		uint64_t SegmentsCount() const
+		{
+			return header_->segmentsCount;
+		}
+
+		int64_t SegmentName(uint64_t segment) const
+		{
+			return segmentName_[segment];
+		}
+
+		uint64_t SegmentLength(uint64_t segment) const
+		{
+			return segmentOffset_[segment + 1] - segmentOffset_[segment];
+		}
+
+		//Returns a character of the segment on the direct strand
+		char SegmentChar(uint64_t segment, uint64_t pos) const
+		{
+			uint64_t base = segmentOffset_[segment] + pos;
+			if (std::binary_search(nPosition_, nPosition_ + header_->nCount, base))
+			{
+				return 'N';
+			}
+
+			return "ACGT"[(sequence_[base >> 2] >> ((base & 3) << 1)) & 3];
+		}
+
+		void SegmentSequence(uint64_t oriented, std::string & buf) const
+		{
+			uint64_t segment = Segment(oriented);
+			uint64_t length = SegmentLength(segment);
+			buf.resize(length);
+			for (uint64_t i = 0; i < length; i++)
+			{
+				buf[i] = SegmentChar(segment, i);
+			}
+
+			if (!IsPositive(oriented))
+			{
+				std::reverse(buf.begin(), buf.end());
+				for (char & ch : buf)
+				{
+					ch = ch == 'A' ? 'T' : (ch == 'C' ? 'G' : (ch == 'G' ? 'C' : (ch == 'T' ? 'A' : 'N')));
+				}
+			}
+		}
+
+		//Oriented segments that follow the oriented segment in the input
+		const uint64_t * LinksBegin(uint64_t oriented) const
+		{
+			return linkTarget_ + linkOffset_[oriented];
+		}
+
+		const uint64_t * LinksEnd(uint64_t oriented) const
+		{
+			return linkTarget_ + linkOffset_[oriented + 1];
+		}
+
+		uint64_t LinksCount() const
+		{
+			return header_->linksCount;
+		}
+
+		uint64_t PathsCount() const
+		{
+			return header_->pathsCount;
+		}
+
+		std::string PathName(uint64_t path) const
+		{
+			return std::string(pathName_ + pathNameOffset_[path], pathName_ + pathNameOffset_[path + 1]);
+		}
+
+		const uint64_t * PathBegin(uint64_t path) const
+		{
+			return pathStep_ + pathOffset_[path];
+		}
+
+		const uint64_t * PathEnd(uint64_t path) const
+		{
+			return pathStep_ + pathOffset_[path + 1];
+		}
+
+	private:
+		template<class T>
+		const T * Section(size_t id) const
+		{
+			return reinterpret_cast<const T*>(data_ + header_->section[id].offset);
+		}
+
+		size_t size_;
+		const char * data_;
+		const CompactedGraphHeader * header_;
+		const uint64_t * segmentOffset_;
+		const int64_t * segmentName_;
+		const uint8_t * sequence_;
+		const uint64_t * nPosition_;
+		const uint64_t * linkOffset_;
+		const uint64_t * linkTarget_;
+		const uint64_t * pathOffset_;
+		const uint64_t * pathStep_;
+		const uint64_t * pathNameOffset_;
+		const char * pathName_;
+		CompactedGraph(const CompactedGraph &);
+		void operator = (const CompactedGraph &);
+	};
+}
+
+#endif
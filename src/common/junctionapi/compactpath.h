@@ -0,0 +1,168 @@
+#ifndef _COMPACT_PATH_H_
+#define _COMPACT_PATH_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace TwoPaCo
+{
+	//Paths of the genomes through the graph written by "graphdump --pathfile". A path
+	//is a sequence of signed segment ids, same as in the P (GFA1) or O (GFA2) records.
+	//Each step is stored as a zigzag-encoded difference with the previous step
+	//written as a varint. The file layout is:
+	//	magic, version (uint64_t)
+	//	records: varint name length, name, varint steps count, varint body size, body
+	//	uint64_t[paths] record offsets, uint64_t paths count
+	class CompactPath
+	{
+	public:
+		static const uint64_t VERSION = 1;
+
+		static const char * Magic()
+		{
+			return "TPCPATHS";
+		}
+
+		static void PutVarint(uint64_t value, std::string & out)
+		{
+			for (; value >= 0x80; value >>= 7)
+			{
+				out.push_back(char(value | 0x80));
+			}
+
+			out.push_back(char(value));
+		}
+
+		static uint64_t GetVarint(const char *& it, const char * end)
+		{
+			uint64_t ret = 0;
+			for (size_t shift = 0; it != end && shift < 64; shift += 7)
+			{
+				uint64_t byte = uint8_t(*it++);
+				ret |= (byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+				{
+					return ret;
+				}
+			}
+
+			throw std::runtime_error("The path is corrupted");
+		}
+
+		static void Encode(const std::vector<int64_t> & path, std::string & out)
+		{
+			int64_t prev = 0;
+			for (int64_t step : path)
+			{
+				int64_t delta = step - prev;
+				PutVarint((uint64_t(delta) << 1) ^ uint64_t(delta >> 63), out);
+				prev = step;
+			}
+		}
+
+		static void Decode(const char * it, const char * end, std::vector<int64_t> & path)
+		{
+			int64_t prev = 0;
+			path.clear();
+			while (it != end)
+			{
+				uint64_t zigzag = GetVarint(it, end);
+				prev += int64_t((zigzag >> 1) ^ (0 - (zigzag & 1)));
+				path.push_back(prev);
+			}
+		}
+
+		static void EncodeRecord(const std::string & name, const std::vector<int64_t> & path, std::string & out)
+		{
+			std::string body;
+			Encode(path, body);
+			PutVarint(name.size(), out);
+			out += name;
+			PutVarint(path.size(), out);
+			PutVarint(body.size(), out);
+			out += body;
+		}
+	};
+
+	class CompactPathReader
+	{
+	public:
+		CompactPathReader(const std::string & fileName) : in_(fileName.c_str(), std::ios::binary)
+		{
+			char magic[8];
+			uint64_t version;
+			if (!in_.read(magic, sizeof(magic)) || !in_.read(reinterpret_cast<char*>(&version), sizeof(version)) ||
+				memcmp(magic, CompactPath::Magic(), sizeof(magic)) != 0 || version != CompactPath::VERSION)
+			{
+				throw std::runtime_error("Can't read the path file");
+			}
+
+			uint64_t count;
+			in_.seekg(-int64_t(sizeof(count)), std::ios::end);
+			in_.read(reinterpret_cast<char*>(&count), sizeof(count));
+			offset_.resize(count);
+			in_.seekg(-int64_t(sizeof(count) * (count + 1)), std::ios::end);
+			if (count > 0)
+			{
+				in_.read(reinterpret_cast<char*>(&offset_[0]), sizeof(offset_[0]) * count);
+			}
+
+			if (!in_)
+			{
+				throw std::runtime_error("The path file is corrupted");
+			}
+		}
+
+		size_t PathsCount() const
+		{
+			return offset_.size();
+		}
+
+		void ReadPath(size_t idx, std::string & name, std::vector<int64_t> & path)
+		{
+			in_.seekg(offset_[idx]);
+			name.resize(ReadVarint());
+			if (name.size() > 0)
+			{
+				in_.read(&name[0], name.size());
+			}
+
+			uint64_t steps = ReadVarint();
+			std::string body(ReadVarint(), ' ');
+			if (body.size() > 0)
+			{
+				in_.read(&body[0], body.size());
+			}
+
+			if (!in_)
+			{
+				throw std::runtime_error("The path file is corrupted");
+			}
+
+			CompactPath::Decode(body.data(), body.data() + body.size(), path);
+			if (path.size() != steps)
+			{
+				throw std::runtime_error("The path file is corrupted");
+			}
+		}
+
+	private:
+		uint64_t ReadVarint()
+		{
+			char buf[10];
+			size_t size = 0;
+			while (size < sizeof(buf) && in_.get(buf[size]) && (buf[size++] & 0x80) != 0);
+			const char * it = buf;
+			return CompactPath::GetVarint(it, buf + size);
+		}
+
+		std::ifstream in_;
+		std::vector<uint64_t> offset_;
+	};
+}
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef _JUNCTION_POSITION_API_H_
 #define _JUNCTION_POSITION_API_H_
 
+#include <vector>
 #include <fstream>
 #include <cstdint>
+#include <functional>
 #include <exception>
 
 namespace TwoPaCo
@@ -41,7 +43,10 @@ namespace TwoPaCo
 	class JunctionPositionReader
 	{
 	public:
-		JunctionPositionReader(const std::string & inFileName) : nowChr_(0), in_(inFileName.c_str(), std::ios::binary)
+		//Bytes taken by a junction in the file
+		static const uint64_t RECORD_BYTES = sizeof(uint32_t) + sizeof(int64_t);
+
+		JunctionPositionReader(const std::string & inFileName) : nowChr_(0), offset_(0), in_(inFileName.c_str(), std::ios::binary)
 		{
 			if (!in_)
 			{
@@ -62,12 +67,41 @@ namespace TwoPaCo
 				else
 				{
 					size_t cur = in_.tellg();
-					in_.seekg(cur - sizeof(pos.pos_) - sizeof(pos.bifId_), in_.beg);
+					in_.seekg(cur - RECORD_BYTES, in_.beg);
+					offset_ -= RECORD_BYTES;
 					break;					
 				}
 			}
 		}
 
+		//Moves to the junctions of the sequence chr starting at the given byte offset,
+		//see JunctionPositionWriter::GetChrOffset
+		void Seek(uint32_t chr, uint64_t offset)
+		{
+			in_.clear();
+			in_.seekg(offset);
+			nowChr_ = chr;
+			offset_ = offset;
+		}
+
+		//Byte offset of the junction returned by the last NextJunctionPosition
+		uint64_t GetOffset() const
+		{
+			return offset_ - RECORD_BYTES;
+		}
+
+		//Reads the junction at the given byte offset, which belongs to the sequence chr.
+		//Returns false if there is a sequence separator or the end of the file instead
+		bool ReadAt(uint32_t chr, uint64_t offset, JunctionPosition & pos)
+		{
+			Seek(chr, offset);
+			pos = JunctionPosition(chr, 0, 0);
+			in_.read(reinterpret_cast<char*>(&pos.pos_), sizeof(pos.pos_));
+			in_.read(reinterpret_cast<char*>(&pos.bifId_), sizeof(pos.bifId_));
+			offset_ += RECORD_BYTES;
+			return in_ && pos.pos_ != JunctionPosition::SEPARATOR_POS && pos.bifId_ != JunctionPosition::SEPARATOR_BIF;
+		}
+
 		void RestoreAllVectors(std::vector<std::vector<bool> > & mark)
 		{
 			JunctionPosition pos;
@@ -90,6 +124,7 @@ namespace TwoPaCo
 					return false;
 				}
 
+				offset_ += RECORD_BYTES;
 				if (pos.pos_ != JunctionPosition::SEPARATOR_POS && pos.bifId_ != JunctionPosition::SEPARATOR_BIF)
 				{
 					return true;
@@ -99,18 +134,29 @@ namespace TwoPaCo
 
 	private:
 		uint32_t nowChr_;
+		uint64_t offset_;
 		std::ifstream in_;
 	};
 	
 
+	//Receives the junctions in the order they are written
+	typedef std::function<void(const JunctionPosition &)> JunctionCallback;
+
 	class JunctionPositionWriter
 	{
 	public:
-		JunctionPositionWriter(const std::string & outFileName) : nowChr_(0), out_(outFileName.c_str(), std::ios::binary)
-		{			
-			if (!out_)
+		//Every junction is also passed to the callback if it is set, the file is not
+		//written if its name is empty
+		JunctionPositionWriter(const std::string & outFileName, const JunctionCallback & callback = JunctionCallback()) :
+			nowChr_(0), written_(0), chrOffset_(1, 0), callback_(callback)
+		{
+			if (!outFileName.empty())
 			{
-				throw std::runtime_error("Can't create the output file");
+				out_.open(outFileName.c_str(), std::ios::binary);
+				if (!out_)
+				{
+					throw std::runtime_error("Can't create the output file");
+				}
 			}
 		}
 
@@ -118,20 +164,49 @@ namespace TwoPaCo
 		{
 			for (; pos.chr_ > nowChr_; ++nowChr_)
 			{
-				WriteJunction(JunctionPosition(nowChr_, JunctionPosition::SEPARATOR_POS, JunctionPosition::SEPARATOR_BIF));
+				WriteRecord(JunctionPosition(nowChr_, JunctionPosition::SEPARATOR_POS, JunctionPosition::SEPARATOR_BIF));
+				chrOffset_.push_back(written_);
 			}
 
-			out_.write(reinterpret_cast<const char*>(&pos.pos_), sizeof(pos.pos_));
-			out_.write(reinterpret_cast<const char*>(&pos.bifId_), sizeof(pos.bifId_));
-
-			if (!out_)
+			if (callback_)
 			{
-				throw std::runtime_error("Can't write to the output file");
+				callback_(pos);
 			}
+
+			WriteRecord(pos);
+		}
+
+		uint64_t GetWritten() const
+		{
+			return written_;
+		}
+
+		//Byte offset of the first junction of the sequence chr in the output, or
+		//UINT64_MAX if nothing for the sequence has been written yet
+		uint64_t GetChrOffset(uint32_t chr) const
+		{
+			return chr < chrOffset_.size() ? chrOffset_[chr] : UINT64_MAX;
 		}
 
 	private:
+		void WriteRecord(JunctionPosition pos)
+		{
+			written_ += sizeof(pos.pos_) + sizeof(pos.bifId_);
+			if (out_.is_open())
+			{
+				out_.write(reinterpret_cast<const char*>(&pos.pos_), sizeof(pos.pos_));
+				out_.write(reinterpret_cast<const char*>(&pos.bifId_), sizeof(pos.bifId_));
+				if (!out_)
+				{
+					throw std::runtime_error("Can't write to the output file");
+				}
+			}
+		}
+
 		uint32_t nowChr_;
+		uint64_t written_;
+		std::vector<uint64_t> chrOffset_;
+		JunctionCallback callback_;
 		std::ofstream out_;
 	};
 }
@@ -0,0 +1,113 @@
+#ifndef _JUNCTION_MEMBERSHIP_H_
+#define _JUNCTION_MEMBERSHIP_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace TwoPaCo
+{
+	//A sidecar of the junctions file telling which genomes contain every junction. The
+	//genomes are the input files numbered as by SequenceManifest::GetGenomes. The file
+	//starts with the number of junctions and of genomes, followed by a row of
+	//RowBytes(genomes) bytes per junction, bit g of the row of the junction id is set
+	//if the genome g contains the junction in any orientation. The rows have the same
+	//width, so a presence query is one seek and one read. Sequence ends are not
+	//junctions and have no rows
+	class JunctionMembershipReader
+	{
+	public:
+		static std::string DefaultFileName(const std::string & junctionsFileName)
+		{
+			return junctionsFileName + ".membership";
+		}
+
+		static uint64_t RowBytes(uint64_t genomes)
+		{
+			return (genomes + 7) / 8;
+		}
+
+		static uint64_t HeaderBytes()
+		{
+			return sizeof(uint64_t) * 2;
+		}
+
+		JunctionMembershipReader(const std::string & inFileName) : junctions_(0), genomes_(0), in_(inFileName.c_str(), std::ios::binary)
+		{
+			in_.read(reinterpret_cast<char*>(&junctions_), sizeof(junctions_));
+			in_.read(reinterpret_cast<char*>(&genomes_), sizeof(genomes_));
+			if (!in_)
+			{
+				throw std::runtime_error("Can't read the membership file");
+			}
+		}
+
+		uint64_t GetJunctionsCount() const
+		{
+			return junctions_;
+		}
+
+		uint64_t GetGenomesCount() const
+		{
+			return genomes_;
+		}
+
+		//The id is the one of the junctions file, its sign is ignored
+		bool Contains(int64_t id, uint32_t genome)
+		{
+			if (genome >= genomes_)
+			{
+				return false;
+			}
+
+			char byte;
+			Seek(id, genome / 8);
+			in_.read(&byte, 1);
+			if (!in_)
+			{
+				throw std::runtime_error("Can't read the membership file");
+			}
+
+			return (byte >> (genome % 8) & 1) != 0;
+		}
+
+		void ReadRow(int64_t id, std::vector<bool> & member)
+		{
+			std::vector<char> row(RowBytes(genomes_));
+			Seek(id, 0);
+			in_.read(row.data(), row.size());
+			if (!in_)
+			{
+				throw std::runtime_error("Can't read the membership file");
+			}
+
+			member.assign(genomes_, false);
+			for (uint64_t genome = 0; genome < genomes_; genome++)
+			{
+				member[genome] = (row[genome / 8] >> (genome % 8) & 1) != 0;
+			}
+		}
+
+	private:
+		void Seek(int64_t id, uint64_t byte)
+		{
+			uint64_t junction = std::llabs(id);
+			if (junction == 0 || junction > junctions_)
+			{
+				throw std::runtime_error("The junction id is out of range");
+			}
+
+			in_.clear();
+			in_.seekg(HeaderBytes() + (junction - 1) * RowBytes(genomes_) + byte);
+		}
+
+		uint64_t junctions_;
+		uint64_t genomes_;
+		std::ifstream in_;
+	};
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef _SEQUENCE_MANIFEST_H_
+#define _SEQUENCE_MANIFEST_H_
+
+#include <cctype>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace TwoPaCo
+{
+	//Location of one input FASTA record. The offset points to the first byte of the
+	//sequence body. If all lines of the record (except the last one) have the same
+	//layout, lineWidth and lineBytes are the number of bases and bytes per line,
+	//otherwise they are zero and the record can only be read sequentially.
+	//junctionsOffset is the position of the first junction of the record in the
+	//junctions file, UINT64_MAX if unknown.
+	struct SequenceRecord
+	{
+		std::string fileName;
+		std::string header;
+		uint64_t length;
+		uint64_t offset;
+		uint64_t lineWidth;
+		uint64_t lineBytes;
+		uint64_t junctionsOffset;
+
+		SequenceRecord() : length(0), offset(0), lineWidth(0), lineBytes(0), junctionsOffset(UINT64_MAX) {}
+		SequenceRecord(const std::string & fileName, const std::string & header, uint64_t length, uint64_t offset, uint64_t lineWidth, uint64_t lineBytes) :
+			fileName(fileName), header(header), length(length), offset(offset), lineWidth(lineWidth), lineBytes(lineBytes), junctionsOffset(UINT64_MAX) {}
+	};
+
+	//A sidecar of the junctions file listing all input records in the order
+	//they were processed, so they don't have to be parsed again
+	class SequenceManifest
+	{
+	public:
+		static std::string DefaultFileName(const std::string & junctionsFileName)
+		{
+			return junctionsFileName + ".manifest";
+		}
+
+		void Add(const SequenceRecord & record)
+		{
+			record_.push_back(record);
+		}
+
+		size_t Size() const
+		{
+			return record_.size();
+		}
+
+		const SequenceRecord & operator [] (size_t idx) const
+		{
+			return record_[idx];
+		}
+
+		void SetJunctionsOffset(size_t idx, uint64_t junctionsOffset)
+		{
+			record_[idx].junctionsOffset = junctionsOffset;
+		}
+
+		void WriteToFile(const std::string & fileName) const
+		{
+			std::ofstream out(fileName.c_str());
+			if (!out)
+			{
+				throw std::runtime_error("Can't create the manifest file");
+			}
+
+			for (const SequenceRecord & record : record_)
+			{
+				out << record.fileName << '\t' << record.header << '\t' << record.length << '\t'
+					<< record.offset << '\t' << record.lineWidth << '\t' << record.lineBytes << '\t';
+				if (record.junctionsOffset != UINT64_MAX)
+				{
+					out << record.junctionsOffset;
+				}
+
+				out << std::endl;
+			}
+
+			if (!out)
+			{
+				throw std::runtime_error("Can't write to the manifest file");
+			}
+		}
+
+		bool ReadFromFile(const std::string & fileName)
+		{
+			record_.clear();
+			std::ifstream in(fileName.c_str());
+			if (!in)
+			{
+				return false;
+			}
+
+			for (std::string line; std::getline(in, line);)
+			{
+				SequenceRecord record;
+				std::stringstream ss(line);
+				std::getline(ss, record.fileName, '\t');
+				std::getline(ss, record.header, '\t');
+				if (!(ss >> record.length >> record.offset >> record.lineWidth >> record.lineBytes))
+				{
+					throw std::runtime_error("The manifest file is corrupted");
+				}
+
+				if (!(ss >> record.junctionsOffset))
+				{
+					record.junctionsOffset = UINT64_MAX;
+				}
+
+				record_.push_back(record);
+			}
+
+			return true;
+		}
+
+		//Checks that the manifest was produced from exactly these files in this order
+		bool Matches(const std::vector<std::string> & fileName) const
+		{
+			size_t file = 0;
+			for (size_t i = 0; i < record_.size(); i++)
+			{
+				if (i > 0 && record_[i].fileName != record_[i - 1].fileName)
+				{
+					++file;
+				}
+
+				if (file >= fileName.size() || record_[i].fileName != fileName[file])
+				{
+					return false;
+				}
+			}
+
+			return record_.empty() ? fileName.empty() : file + 1 == fileName.size();
+		}
+
+		//Numbers the genomes of the records: the records of one file form a genome and a
+		//new one starts whenever the file changes. The records held in memory have no
+		//file and are genomes of their own. Returns the number of genomes
+		uint32_t GetGenomes(std::vector<uint32_t> & genome) const
+		{
+			genome.resize(record_.size());
+			for (size_t i = 0; i < record_.size(); i++)
+			{
+				bool same = i > 0 && !record_[i].fileName.empty() && record_[i].fileName == record_[i - 1].fileName;
+				genome[i] = i == 0 ? 0 : genome[i - 1] + (same ? 0 : 1);
+			}
+
+			return record_.empty() ? 0 : genome.back() + 1;
+		}
+
+		//Reads length bases of the record idx starting from the position start
+		void ReadSequence(size_t idx, uint64_t start, uint64_t length, std::string & buf) const
+		{
+			const SequenceRecord & record = record_[idx];
+			buf.clear();
+			if (start >= record.length)
+			{
+				return;
+			}
+
+			length = std::min(length, record.length - start);
+			std::ifstream in(record.fileName.c_str(), std::ios::binary);
+			if (!in)
+			{
+				throw std::runtime_error("Can't open file " + record.fileName);
+			}
+
+			uint64_t skip = start;
+			uint64_t offset = record.offset;
+			if (record.lineWidth > 0)
+			{
+				offset += start / record.lineWidth * record.lineBytes + start % record.lineWidth;
+				skip = 0;
+			}
+
+			in.seekg(offset);
+			buf.reserve(length);
+			for (char ch; buf.size() < length && in.get(ch);)
+			{
+				if (!isspace(ch))
+				{
+					if (skip > 0)
+					{
+						--skip;
+					}
+					else
+					{
+						buf.push_back(toupper(ch));
+					}
+				}
+			}
+
+			if (buf.size() != length)
+			{
+				throw std::runtime_error("Can't read the record " + record.header + " from " + record.fileName);
+			}
+		}
+
+	private:
+		std::vector<SequenceRecord> record_;
+	};
+}
+
+#endif
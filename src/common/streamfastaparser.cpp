@@ -5,6 +5,67 @@
 
 namespace TwoPaCo
 {
+	namespace
+	{
+		//Serves the header lines and points the get area directly into the sequences
+		class MemoryFastaBuffer : public std::streambuf
+		{
+		public:
+			MemoryFastaBuffer(const std::vector<std::string> & sequence, const std::vector<std::string> & header) : part_(0), sequence_(sequence), header_(header)
+			{
+
+			}
+
+		protected:
+			int_type underflow()
+			{
+				while (gptr() == egptr())
+				{
+					size_t record = part_ / 2;
+					if (record >= sequence_.size())
+					{
+						return traits_type::eof();
+					}
+
+					char * start;
+					size_t size;
+					if (part_++ % 2 == 0)
+					{
+						std::stringstream ss;
+						ss << (record > 0 ? "\n>" : ">");
+						if (record < header_.size())
+						{
+							ss << header_[record];
+						}
+						else
+						{
+							ss << record;
+						}
+
+						ss << '\n';
+						line_ = ss.str();
+						start = &line_[0];
+						size = line_.size();
+					}
+					else
+					{
+						start = const_cast<char*>(sequence_[record].data());
+						size = sequence_[record].size();
+					}
+
+					setg(start, start, start + size);
+				}
+
+				return traits_type::to_int_type(*gptr());
+			}
+
+		private:
+			size_t part_;
+			std::string line_;
+			const std::vector<std::string> & sequence_;
+			const std::vector<std::string> & header_;
+		};
+	}
 
 	StreamFastaParser::Exception::Exception(const std::string & msg) : std::runtime_error(msg)
 	{
@@ -16,15 +77,24 @@ namespace TwoPaCo
 		delete [] buffer_;
 	}
 
-	StreamFastaParser::StreamFastaParser(const std::string & fileName) : stream_(fileName.c_str()),
-		buffer_(new char[BUF_SIZE]), bufferPos_(0), bufferSize_(0)
+	StreamFastaParser::StreamFastaParser(const std::string & fileName) : file_(fileName.c_str()), stream_(file_.rdbuf()),
+		buffer_(new char[BUF_SIZE]), bufferPos_(0), bufferSize_(0), streamPos_(0), currentOffset_(0),
+		lineStart_(0), lineBases_(0), lineWidth_(0), lineBytes_(0), shortLine_(false), irregular_(false)
 	{
-		if (!stream_ && !stream_.eof())
+		if (!file_ && !file_.eof())
 		{
 			throw Exception("Can't open file " + fileName);
 		}
 	}
 
+	StreamFastaParser::StreamFastaParser(const std::vector<std::string> & sequence, const std::vector<std::string> & header) :
+		memory_(new MemoryFastaBuffer(sequence, header)), stream_(memory_.get()),
+		buffer_(new char[BUF_SIZE]), bufferPos_(0), bufferSize_(0), streamPos_(0), currentOffset_(0),
+		lineStart_(0), lineBases_(0), lineWidth_(0), lineBytes_(0), shortLine_(false), irregular_(false)
+	{
+
+	}
+
 	bool StreamFastaParser::ReadRecord()
 	{
 		char ch = '\0';
@@ -54,9 +124,38 @@ namespace TwoPaCo
 			}
 		}
 
+		currentOffset_ = lineStart_ = streamPos_;
+		lineBases_ = lineWidth_ = lineBytes_ = 0;
+		shortLine_ = irregular_ = false;
 		return true;
 	}
 
+	void StreamFastaParser::EndLine()
+	{
+		if (lineBases_ > 0)
+		{
+			uint64_t bytes = streamPos_ - lineStart_;
+			if (lineWidth_ == 0)
+			{
+				lineWidth_ = lineBases_;
+				lineBytes_ = bytes;
+			}
+			else if (lineBases_ != lineWidth_ || bytes != lineBytes_)
+			{
+				//Only the last line of a record is allowed to be shorter
+				irregular_ = irregular_ || lineBases_ > lineWidth_;
+				shortLine_ = true;
+			}
+		}
+		else
+		{
+			shortLine_ = true;
+		}
+
+		lineBases_ = 0;
+		lineStart_ = streamPos_;
+	}
+
 	bool StreamFastaParser::GetChar(char & ch)
 	{
 		while (true)
@@ -69,6 +168,11 @@ namespace TwoPaCo
 			if (isspace(ch))
 			{
 				GetCh(ch);
+				if (ch == '\n')
+				{
+					EndLine();
+				}
+
 				continue;
 			}
 			else if (ch == '>')
@@ -84,6 +188,8 @@ namespace TwoPaCo
 
 				GetCh(ch);
 				ch = toupper(ch);
+				irregular_ = irregular_ || shortLine_;
+				++lineBases_;
 				return true;
 			}
 		}
@@ -108,6 +214,7 @@ namespace TwoPaCo
 		}
 
 		ch = buffer_[bufferPos_++];
+		++streamPos_;
 		return true;
 	}
 
@@ -137,8 +244,53 @@ namespace TwoPaCo
 		return currentHeader_;
 	}
 
+	uint64_t StreamFastaParser::GetCurrentOffset() const
+	{
+		return currentOffset_;
+	}
+
+	uint64_t StreamFastaParser::GetLineWidth() const
+	{
+		return irregular_ ? 0 : (lineWidth_ > 0 ? lineWidth_ : lineBases_);
+	}
+
+	uint64_t StreamFastaParser::GetLineBytes() const
+	{
+		return irregular_ ? 0 : (lineWidth_ > 0 ? lineBytes_ : lineBases_ + 1);
+	}
+
 	std::string StreamFastaParser::GetErrorMessage() const
 	{
 		return errorMessage_;
 	}
+
+	FastaInput::FastaInput(const std::vector<std::string> & fileName) : fileName_(fileName), sequence_(0), header_(0)
+	{
+
+	}
+
+	FastaInput::FastaInput(const std::vector<std::string> & sequence, const std::vector<std::string> & header) : fileName_(1), sequence_(&sequence), header_(header)
+	{
+
+	}
+
+	size_t FastaInput::Size() const
+	{
+		return fileName_.size();
+	}
+
+	const std::string & FastaInput::GetName(size_t source) const
+	{
+		return fileName_[source];
+	}
+
+	std::unique_ptr<StreamFastaParser> FastaInput::Open(size_t source) const
+	{
+		if (sequence_ != 0)
+		{
+			return std::unique_ptr<StreamFastaParser>(new StreamFastaParser(*sequence_, header_));
+		}
+
+		return std::unique_ptr<StreamFastaParser>(new StreamFastaParser(fileName_[source]));
+	}
 }
@@ -2,7 +2,9 @@
 #define _STREAM_FASTA_PARSER_H_
 
 #include <vector>
+#include <memory>
 #include <fstream>
+#include <istream>
 #include <stdexcept>
 #include <algorithm>
 #include <tbb/mutex.h>
@@ -25,19 +27,55 @@ namespace TwoPaCo
 		bool GetChar(char & ch);		
 		std::string GetErrorMessage() const;
 		std::string GetCurrentHeader() const;
+		uint64_t GetCurrentOffset() const;
+		uint64_t GetLineWidth() const;
+		uint64_t GetLineBytes() const;
 		StreamFastaParser(const std::string & fileName);
+		//Reads the sequences held in memory as the records of a FASTA file, record i
+		//gets header[i] or its number if there are fewer headers. Nothing is copied
+		StreamFastaParser(const std::vector<std::string> & sequence, const std::vector<std::string> & header);
 	private:				
 		static const size_t BUF_SIZE = 1 << 20;
 
 		bool Peek(char & ch);
 		bool GetCh(char & ch);		
+		void EndLine();
 
-		std::ifstream stream_;
+		std::unique_ptr<std::streambuf> memory_;
+		std::ifstream file_;
+		std::istream stream_;
 		std::string errorMessage_;
 		std::string currentHeader_;
 		char * buffer_;
 		size_t bufferSize_;
 		size_t bufferPos_;
+		uint64_t streamPos_;
+		uint64_t currentOffset_;
+		uint64_t lineStart_;
+		uint64_t lineBases_;
+		uint64_t lineWidth_;
+		uint64_t lineBytes_;
+		bool shortLine_;
+		bool irregular_;
+	};
+
+	//Genomes to build the graph of: FASTA files or sequences held in memory. The
+	//latter are read as one FASTA file named by an empty string and are not copied,
+	//so they must outlive the input
+	class FastaInput
+	{
+	public:
+		FastaInput(const std::vector<std::string> & fileName);
+		FastaInput(const std::vector<std::string> & sequence, const std::vector<std::string> & header);
+		//The number of files, the sequences in memory count as one
+		size_t Size() const;
+		const std::string & GetName(size_t source) const;
+		std::unique_ptr<StreamFastaParser> Open(size_t source) const;
+
+	private:
+		std::vector<std::string> fileName_;
+		const std::vector<std::string> * sequence_;
+		std::vector<std::string> header_;
 	};
 
 	struct NewTask
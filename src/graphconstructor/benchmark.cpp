@@ -0,0 +1,427 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <tclap/CmdLine.h>
+
+#include "test.h"
+#include "vertexenumerator.h"
+
+namespace
+{
+	const size_t LINE_WIDTH = 60;
+
+	std::vector<uint64_t> ParseList(const std::string & str)
+	{
+		uint64_t value;
+		std::vector<uint64_t> ret;
+		std::stringstream ss(str);
+		for (std::string item; std::getline(ss, item, ',');)
+		{
+			std::stringstream itemStream(item);
+			if (!(itemStream >> value))
+			{
+				throw std::runtime_error("Can't parse the list " + str);
+			}
+
+			ret.push_back(value);
+		}
+
+		return ret;
+	}
+
+	//Generates the genomes and writes every one into a separate FASTA file split into contigs
+	std::vector<std::string> GenerateCollection(const std::string & directory,
+		uint32_t seed,
+		size_t length,
+		size_t genomes,
+		size_t contigs,
+		double divergence,
+		double indelRate,
+		double nRate,
+		uint64_t & bases)
+	{
+		std::string base;
+		std::vector<std::string> ret;
+		bases = 0;
+		TwoPaCo::GenerateSequence(seed, length, base, nRate);
+		for (size_t i = 0; i < genomes; i++)
+		{
+			std::string genome;
+			if (i == 0)
+			{
+				genome = base;
+			}
+			else
+			{
+				TwoPaCo::MutateSequence(seed + uint32_t(i), base, divergence, 1 - indelRate, genome);
+			}
+
+			bases += genome.size();
+			std::stringstream fileName;
+			fileName << directory << "/genome_" << i << ".fa";
+			std::ofstream out(fileName.str().c_str());
+			size_t contigLength = genome.size() / contigs + 1;
+			for (size_t contig = 0; contig * contigLength < genome.size(); contig++)
+			{
+				out << ">genome_" << i << "_" << contig << std::endl;
+				std::string body = genome.substr(contig * contigLength, contigLength);
+				for (size_t pos = 0; pos < body.size(); pos += LINE_WIDTH)
+				{
+					out << body.substr(pos, LINE_WIDTH) << std::endl;
+				}
+			}
+
+			if (!out)
+			{
+				throw std::runtime_error("Can't write the genome " + fileName.str());
+			}
+
+			ret.push_back(fileName.str());
+		}
+
+		return ret;
+	}
+
+	uint64_t DirectorySize(const std::string & directory)
+	{
+		uint64_t ret = 0;
+		DIR * dir = opendir(directory.c_str());
+		if (dir != 0)
+		{
+			for (dirent * entry = readdir(dir); entry != 0; entry = readdir(dir))
+			{
+				struct stat st;
+				if (stat((directory + "/" + entry->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode))
+				{
+					ret += st.st_size;
+				}
+			}
+
+			closedir(dir);
+		}
+
+		return ret;
+	}
+
+	void ClearDirectory(const std::string & directory)
+	{
+		DIR * dir = opendir(directory.c_str());
+		if (dir != 0)
+		{
+			for (dirent * entry = readdir(dir); entry != 0; entry = readdir(dir))
+			{
+				std::string name = entry->d_name;
+				if (name != "." && name != "..")
+				{
+					std::remove((directory + "/" + name).c_str());
+				}
+			}
+
+			closedir(dir);
+		}
+	}
+
+	struct RunResult
+	{
+		double wallTime;
+		double cpuTime;
+		uint64_t peakRss;
+		uint64_t peakTemp;
+		uint64_t junctions;
+	};
+
+	//Runs the construction in a child process so the peak memory is measured for this run only,
+	//the temporary directory is polled while the child works
+	RunResult Run(const std::vector<std::string> & fileName, size_t k, size_t filterBits, size_t hashFunctions, size_t rounds, size_t threads, const std::string & tmpDir, const std::string & outFileName)
+	{
+		int fd[2];
+		if (pipe(fd) != 0)
+		{
+			throw std::runtime_error("Can't create a pipe");
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		pid_t pid = fork();
+		if (pid == -1)
+		{
+			throw std::runtime_error("Can't start a benchmark process");
+		}
+
+		if (pid == 0)
+		{
+			close(fd[0]);
+			int code = 0;
+			std::stringstream report;
+			try
+			{
+				std::stringstream null;
+				std::unique_ptr<TwoPaCo::VertexEnumerator> vid = TwoPaCo::CreateEnumerator(fileName, k, filterBits, hashFunctions, rounds, threads, tmpDir, outFileName, null);
+				report << vid->GetVerticesCount();
+			}
+			catch (std::runtime_error & e)
+			{
+				report << e.what();
+				code = 1;
+			}
+
+			std::string message = report.str();
+			ssize_t written = write(fd[1], message.data(), message.size());
+			close(fd[1]);
+			_exit(code == 0 && written == ssize_t(message.size()) ? 0 : 1);
+		}
+
+		close(fd[1]);
+		int status = 0;
+		RunResult ret;
+		ret.peakTemp = 0;
+		struct rusage usage;
+		while (wait4(pid, &status, WNOHANG, &usage) == 0)
+		{
+			ret.peakTemp = std::max(ret.peakTemp, DirectorySize(tmpDir));
+			usleep(20000);
+		}
+
+		ret.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::string message;
+		char buf[1024];
+		for (ssize_t size; (size = read(fd[0], buf, sizeof(buf))) > 0;)
+		{
+			message.append(buf, size);
+		}
+
+		close(fd[0]);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			throw std::runtime_error("The benchmark run failed: " + message);
+		}
+
+		std::stringstream ss(message);
+		ss >> ret.junctions;
+		ret.cpuTime = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+		ret.peakRss = uint64_t(usage.ru_maxrss) * 1024;
+		return ret;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	try
+	{
+		TCLAP::CmdLine cmd("Scaling benchmark of the construction on synthetic genomes", ' ', "0.9.2");
+
+		TCLAP::ValueArg<uint64_t> length("",
+			"length",
+			"Length of a genome",
+			false,
+			1000000,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<unsigned int> genomes("",
+			"genomes",
+			"Number of genomes",
+			false,
+			4,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<unsigned int> contigs("",
+			"contigs",
+			"Number of contigs in a genome",
+			false,
+			1,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<double> divergence("",
+			"divergence",
+			"Fraction of positions changed in every genome relative to the first one",
+			false,
+			0.01,
+			"float",
+			cmd);
+
+		TCLAP::ValueArg<double> indelRate("",
+			"indelrate",
+			"Fraction of the changes that are insertions or deletions",
+			false,
+			0.1,
+			"float",
+			cmd);
+
+		TCLAP::ValueArg<double> nRate("",
+			"nrate",
+			"Fraction of N characters in the first genome",
+			false,
+			0.002,
+			"float",
+			cmd);
+
+		TCLAP::ValueArg<unsigned int> seed("",
+			"seed",
+			"Seed of the genome generator",
+			false,
+			1,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<std::string> kvalues("k",
+			"kvalues",
+			"Comma-separated values of k",
+			false,
+			"25",
+			"list",
+			cmd);
+
+		TCLAP::ValueArg<std::string> threads("t",
+			"threads",
+			"Comma-separated numbers of worker threads",
+			false,
+			"1,2,4",
+			"list",
+			cmd);
+
+		TCLAP::ValueArg<std::string> rounds("r",
+			"rounds",
+			"Comma-separated numbers of computation rounds",
+			false,
+			"1",
+			"list",
+			cmd);
+
+		TCLAP::ValueArg<std::string> filterSize("f",
+			"filtersize",
+			"Comma-separated sizes of the filter",
+			false,
+			"24",
+			"list",
+			cmd);
+
+		TCLAP::ValueArg<unsigned int> hashFunctions("q",
+			"hashfnumber",
+			"Number of hash functions",
+			false,
+			5,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<unsigned int> repeat("",
+			"repeat",
+			"Number of runs of every configuration",
+			false,
+			1,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<std::string> label("",
+			"label",
+			"Label of the build written in every row",
+			false,
+			"",
+			"string",
+			cmd);
+
+		TCLAP::ValueArg<std::string> tmpDirName("",
+			"tmpdir",
+			"Temporary directory name",
+			false,
+			".",
+			"directory name",
+			cmd);
+
+		TCLAP::ValueArg<std::string> outFileName("o",
+			"outfile",
+			"Output CSV file name, the standard output by default",
+			false,
+			"",
+			"file name",
+			cmd);
+
+		cmd.parse(argc, argv);
+		std::string genomeDir = tmpDirName.getValue() + "/bench_genomes";
+		std::string runDir = tmpDirName.getValue() + "/bench_run";
+		std::string junctionsFileName = tmpDirName.getValue() + "/bench_junctions.bin";
+		mkdir(genomeDir.c_str(), 0755);
+		mkdir(runDir.c_str(), 0755);
+		uint64_t bases = 0;
+		std::vector<std::string> fileName = GenerateCollection(genomeDir,
+			seed.getValue(),
+			length.getValue(),
+			genomes.getValue(),
+			std::max(1U, contigs.getValue()),
+			divergence.getValue(),
+			indelRate.getValue(),
+			nRate.getValue(),
+			bases);
+
+		std::ofstream outFile;
+		if (outFileName.isSet())
+		{
+			outFile.open(outFileName.getValue().c_str());
+			if (!outFile)
+			{
+				throw std::runtime_error("Can't create the output file");
+			}
+		}
+
+		std::ostream & out = outFileName.isSet() ? outFile : std::cout;
+		out << "label,length,genomes,contigs,divergence,indel_rate,n_rate,seed,filter,k,filter_size,hash_functions,rounds,threads,run,"
+			"wall_seconds,cpu_seconds,peak_rss_bytes,peak_temp_bytes,bases,mbp_per_second,junctions" << std::endl;
+		for (uint64_t k : ParseList(kvalues.getValue()))
+		{
+			for (uint64_t filter : ParseList(filterSize.getValue()))
+			{
+				for (uint64_t r : ParseList(rounds.getValue()))
+				{
+					for (uint64_t t : ParseList(threads.getValue()))
+					{
+						for (size_t run = 0; run < repeat.getValue(); run++)
+						{
+							RunResult result = Run(fileName, k, filter, hashFunctions.getValue(), r, t, runDir, junctionsFileName);
+							ClearDirectory(runDir);
+							out << label.getValue() << ',' << length.getValue() << ',' << genomes.getValue() << ',' << contigs.getValue() << ','
+								<< divergence.getValue() << ',' << indelRate.getValue() << ',' << nRate.getValue() << ',' << seed.getValue() << ",cuckoo,"
+								<< k << ',' << filter << ',' << hashFunctions.getValue() << ',' << r << ',' << t << ',' << run << ','
+								<< result.wallTime << ',' << result.cpuTime << ',' << result.peakRss << ',' << result.peakTemp << ','
+								<< bases << ',' << bases / result.wallTime / 1e6 << ',' << result.junctions << std::endl;
+						}
+					}
+				}
+			}
+		}
+
+		std::remove(junctionsFileName.c_str());
+		std::remove(TwoPaCo::SequenceManifest::DefaultFileName(junctionsFileName).c_str());
+		ClearDirectory(genomeDir);
+		rmdir(genomeDir.c_str());
+		rmdir(runDir.c_str());
+	}
+	catch (TCLAP::ArgException & e)
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+		return 1;
+	}
+	catch (std::runtime_error & e)
+	{
+		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
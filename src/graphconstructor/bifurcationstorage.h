@@ -2,7 +2,9 @@
 #define _BIFURCATION_STORAGE_H_
 
 #include "common.h"
+#include "tracer.h"
 #include "compressedstring.h"
+#include "vertexrollinghash.h"
 
 
 namespace TwoPaCo
@@ -24,8 +26,19 @@ namespace TwoPaCo
 			return bifurcationKey_.size() * 2;
 		}
 
+		uint64_t GetKeysBytes() const
+		{
+			return bifurcationKey_.capacity() * sizeof(DnaString);
+		}
+
+		uint64_t GetFilterBytes() const
+		{
+			return bifurcationFilter_.capacity() / 8;
+		}
+
 		void Init(std::istream & bifurcationTempRead, uint64_t verticesCount, uint64_t vertexLength, size_t threads)
 		{
+			Tracer::Span span("storage init");
 			uint64_t bitsPower = 0;
 			vertexLength_ = vertexLength;
 			while (verticesCount * 8 >= (uint64_t(1) << bitsPower))
@@ -33,14 +46,9 @@ namespace TwoPaCo
 				++bitsPower;
 			}
 
-			size_t hashFunctionNumber = 3;
 			bitsPower = max(bitsPower, size_t(24));
 			bifurcationFilter_.assign(uint64_t(1) << bitsPower, false);
-			hashFunction_.resize(hashFunctionNumber);
-			for (HashFunctionPtr & ptr : hashFunction_)
-			{
-				ptr.reset(new HashFunction(vertexLength, bitsPower));
-			}
+			hashSeed_.reset(new VertexRollingHashSeed(HASH_FUNCTIONS, vertexLength, bitsPower));
 
 			DnaString buf;
 			std::string stringBuf(vertexLength, ' ');
@@ -54,9 +62,10 @@ namespace TwoPaCo
 
 				buf.ToString(stringBuf, vertexLength);
 				bifurcationKey_.push_back(buf);
-				for (HashFunctionPtr & ptr : hashFunction_)
+				uint64_t value[HASH_FUNCTIONS];
+				hashSeed_->DeriveAll(hashSeed_->PositiveBase(stringBuf.begin(), vertexLength), vertexLength, value, HASH_FUNCTIONS);
+				for (uint64_t hf : value)
 				{
-					uint64_t hf = ptr->hash(stringBuf);
 					bifurcationFilter_[hf] = true;
 				}
 			}
@@ -70,19 +79,23 @@ namespace TwoPaCo
 			return GetId(pos, true, true);
 		}
 
-		int64_t GetId(std::string::const_iterator pos, const std::vector<HashFunctionPtr> & posVertexHash, const std::vector<HashFunctionPtr> & negVertexHash) const
+		//The hash must be created from the seed returned by GetHashSeed
+		int64_t GetId(std::string::const_iterator pos, const VertexRollingHash & hash) const
 		{
+			uint64_t posValue[HASH_FUNCTIONS];
+			uint64_t negValue[HASH_FUNCTIONS];
+			hash.PositiveHashes(posValue, HASH_FUNCTIONS);
+			hash.NegativeHashes(negValue, HASH_FUNCTIONS);
 			bool posFound = true;
 			bool negFound = true;
-			int64_t ret = INVALID_VERTEX;
-			for (size_t i = 0; i < posVertexHash.size() && (posFound || negFound); i++)
+			for (size_t i = 0; i < HASH_FUNCTIONS && (posFound || negFound); i++)
 			{
-				if (!bifurcationFilter_[posVertexHash[i]->hashvalue])
+				if (!bifurcationFilter_[posValue[i]])
 				{
 					posFound = false;
 				}
 
-				if (!bifurcationFilter_[negVertexHash[i]->hashvalue])
+				if (!bifurcationFilter_[negValue[i]])
 				{
 					negFound = false;
 				}
@@ -91,9 +104,35 @@ namespace TwoPaCo
 			return GetId(pos, posFound, negFound);
 		}
 
-		const std::vector<HashFunctionPtr>& GetHashFunctions() const
+		const VertexRollingHashSeed & GetHashSeed() const
+		{
+			return *hashSeed_;
+		}
+
+		const DnaString & GetKey(uint64_t index) const
 		{
-			return hashFunction_;
+			return bifurcationKey_[index];
+		}
+
+		//Index of the key in the sorted keys or INVALID_VERTEX
+		int64_t GetIndex(const DnaString & key) const
+		{
+			auto it = std::lower_bound(bifurcationKey_.begin(), bifurcationKey_.end(), key, DnaString::Less);
+			return it != bifurcationKey_.end() && *it == key ? it - bifurcationKey_.begin() : INVALID_VERTEX;
+		}
+
+		//In the format read by Init
+		void WriteKeys(std::ofstream & out) const
+		{
+			for (const DnaString & key : bifurcationKey_)
+			{
+				key.WriteToFile(out);
+			}
+
+			if (!out)
+			{
+				throw StreamFastaParser::Exception("Can't write the junctions");
+			}
 		}
 
 	private:
@@ -154,10 +193,11 @@ namespace TwoPaCo
 
 		DISALLOW_COPY_AND_ASSIGN(BifurcationStorage<CAPACITY>);
 
+		static const size_t HASH_FUNCTIONS = 3;
 		size_t vertexLength_;
 		std::vector<bool> bifurcationFilter_;
 		std::vector<DnaString> bifurcationKey_;
-		std::vector<HashFunctionPtr> hashFunction_;
+		std::unique_ptr<VertexRollingHashSeed> hashSeed_;
 	};
 }
 
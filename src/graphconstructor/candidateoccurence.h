@@ -5,108 +5,226 @@
 
 namespace TwoPaCo
 {
+	constexpr size_t CalculateNeededCapacity(size_t vertexLength)
+	{
+		return vertexLength / UNIT_CAPACITY + (vertexLength % UNIT_CAPACITY == 0 ? 0 : 1);
+	}
+
+	//The neighbouring characters and the junction flag of an occurence take a byte
+	const size_t OCCURENCE_FLAGS_BITS = 8;
+
+	//Whether the vertex leaves enough unused high bits in the last word of the key for the flags
+	constexpr bool OccurenceFlagsFitKey(size_t vertexLength)
+	{
+		return vertexLength * 2 + OCCURENCE_FLAGS_BITS <= CalculateNeededCapacity(vertexLength) * UNIT_CAPACITY * 2;
+	}
+
+	template<size_t CAPACITY, bool PACKED>
+	class OccurenceBody;
+
+	//The flags are kept in the top byte of the last word of the key, so for k <= 28 the
+	//occurence is a single 64-bit word and for k <= 60 it is a pair of words. The key is
+	//written only before the occurence is inserted into the hash table, afterwards the
+	//last word is accessed atomically since the flags are updated concurrently.
+	template<size_t CAPACITY>
+	class OccurenceBody<CAPACITY, true>
+	{
+	public:
+		OccurenceBody() {}
+		OccurenceBody(const OccurenceBody & toCopy)
+		{
+			CopyFrom(toCopy);
+		}
+
+		OccurenceBody & operator = (const OccurenceBody & toCopy)
+		{
+			CopyFrom(toCopy);
+			return *this;
+		}
+
+		CompressedString<CAPACITY> & Key()
+		{
+			return body_;
+		}
+
+		CompressedString<CAPACITY> GetKey() const
+		{
+			CompressedString<CAPACITY> ret;
+			for (size_t i = 0; i < CAPACITY; i++)
+			{
+				ret.StoreWord(i, body_.LoadWord(i) & (i == LAST ? KEY_MASK : ~uint64_t(0)));
+			}
+
+			return ret;
+		}
+
+		uint8_t Extra() const
+		{
+			return uint8_t(body_.LoadWord(LAST) >> EXTRA_SHIFT);
+		}
+
+		void SetExtra(uint8_t extra)
+		{
+			body_.StoreWord(LAST, (body_.LoadWord(LAST) & KEY_MASK) | (uint64_t(extra) << EXTRA_SHIFT));
+		}
+
+		void AddExtra(uint8_t extra) const
+		{
+			body_.OrWord(LAST, uint64_t(extra) << EXTRA_SHIFT);
+		}
+
+	private:
+		static const size_t LAST = CAPACITY - 1;
+		static const size_t EXTRA_SHIFT = UNIT_CAPACITY * 2 - OCCURENCE_FLAGS_BITS;
+		static const uint64_t KEY_MASK = (uint64_t(1) << EXTRA_SHIFT) - 1;
+
+		void CopyFrom(const OccurenceBody & toCopy)
+		{
+			for (size_t i = 0; i < CAPACITY; i++)
+			{
+				body_.StoreWord(i, toCopy.body_.LoadWord(i));
+			}
+		}
+
+		mutable CompressedString<CAPACITY> body_;
+	};
+
+	//The vertex fills the last word of the key, so the flags are kept in a side byte.
+	//The key never changes after the occurence is inserted into the hash table, only
+	//the byte is updated concurrently, so it is accessed atomically.
 	template<size_t CAPACITY>
+	class OccurenceBody<CAPACITY, false>
+	{
+	public:
+		OccurenceBody() : extra_(0) {}
+		OccurenceBody(const OccurenceBody & toCopy) : body_(toCopy.body_), extra_(toCopy.Extra()) {}
+
+		OccurenceBody & operator = (const OccurenceBody & toCopy)
+		{
+			body_ = toCopy.body_;
+			SetExtra(toCopy.Extra());
+			return *this;
+		}
+
+		CompressedString<CAPACITY> & Key()
+		{
+			return body_;
+		}
+
+		const CompressedString<CAPACITY> & GetKey() const
+		{
+			return body_;
+		}
+
+		uint8_t Extra() const
+		{
+			return __atomic_load_n(&extra_, __ATOMIC_RELAXED);
+		}
+
+		void SetExtra(uint8_t extra)
+		{
+			__atomic_store_n(&extra_, extra, __ATOMIC_RELAXED);
+		}
+
+		void AddExtra(uint8_t extra) const
+		{
+			__atomic_fetch_or(&extra_, extra, __ATOMIC_RELAXED);
+		}
+
+	private:
+		CompressedString<CAPACITY> body_;
+		mutable uint8_t extra_;
+	};
+
+	//An occurence of a candidate vertex with its neighbouring characters. PACKED tells
+	//whether the flags fit into the key, see OccurenceFlagsFitKey. The flags are never
+	//part of the key: the comparison and the hash only see the vertex.
+	template<size_t CAPACITY, bool PACKED>
 	class CandidateOccurence
 	{
 	public:
 		static const size_t IS_PREV_N = 1;
 		static const size_t IS_NEXT_N = 2;
-		static const char TRUE_BIF = 'A';
-		static const char FAKE_BIF = 'C';
-		static const size_t ADDITIONAL_CHAR = 4;
-		static const size_t MAX_SIZE = CAPACITY * 32;
-		static const size_t NEXT_POS = MAX_SIZE - ADDITIONAL_CHAR;
-		static const size_t PREV_POS = NEXT_POS + 1;
-		static const size_t NMASK_POS = NEXT_POS + 2;
-		static const size_t IS_BIF_POS = NEXT_POS + 3;
-		static const size_t VERTEX_SIZE = MAX_SIZE - ADDITIONAL_CHAR;		
-
-		CandidateOccurence(){}
+		static const size_t NEXT_SHIFT = 2;
+		static const size_t PREV_SHIFT = 4;
+		static const size_t IS_BIFURCATION = 64;
+
 		void Set(uint64_t posHash0,
-			uint64_t negHash0,			
+			uint64_t negHash0,
 			std::string::const_iterator pos,
 			size_t vertexLength,
 			char posExtend,
 			char posPrev,
 			bool isBifurcation)
-		{	
+		{
+			uint8_t extra;
 			if (posHash0 < negHash0 || (posHash0 == negHash0 && DnaChar::LessSelfReverseComplement(pos, vertexLength)))
 			{
-				body_.CopyFromString(pos, vertexLength);
-				body_.SetChar(NEXT_POS, posExtend);
-				body_.SetChar(PREV_POS, posPrev);
-				body_.SetChar(NMASK_POS, EncodeNmask(posExtend, posPrev));
+				body_.Key().CopyFromString(pos, vertexLength);
+				extra = Encode(posExtend, posPrev);
 			}
 			else
 			{
-				body_.CopyFromReverseString(pos, vertexLength);
-				body_.SetChar(NEXT_POS, DnaChar::ReverseChar(posPrev));
-				body_.SetChar(PREV_POS, DnaChar::ReverseChar(posExtend));
-				body_.SetChar(NMASK_POS, EncodeNmask(posPrev, posExtend));
+				body_.Key().CopyFromReverseString(pos, vertexLength);
+				extra = Encode(DnaChar::ReverseChar(posPrev), DnaChar::ReverseChar(posExtend));
 			}
 
-			body_.SetChar(IS_BIF_POS, isBifurcation ? TRUE_BIF : FAKE_BIF);
+			body_.SetExtra(uint8_t(extra | (isBifurcation ? IS_BIFURCATION : 0)));
 		}
 
 		char Prev() const
 		{
-			char nmask = body_.RawChar(NMASK_POS);
-			return nmask & IS_PREV_N ? 'N' : body_.GetChar(PREV_POS);
+			uint8_t extra = body_.Extra();
+			return extra & IS_PREV_N ? 'N' : DnaChar::LITERAL[(extra >> PREV_SHIFT) & 0x3];
 		}
 
 		char Next() const
 		{
-			char nmask = body_.RawChar(NMASK_POS);
-			return nmask & IS_NEXT_N ? 'N' : body_.GetChar(NEXT_POS);
+			uint8_t extra = body_.Extra();
+			return extra & IS_NEXT_N ? 'N' : DnaChar::LITERAL[(extra >> NEXT_SHIFT) & 0x3];
 		}
 
 		bool IsBifurcation() const
 		{
-			return body_.GetChar(IS_BIF_POS) == TRUE_BIF;
+			return (body_.Extra() & IS_BIFURCATION) != 0;
 		}
 
 		void MakeBifurcation() const
 		{
-			body_.SetCharConcurrently(IS_BIF_POS, TRUE_BIF);
+			body_.AddExtra(uint8_t(IS_BIFURCATION));
 		}
 
 		bool EqualBase(const CandidateOccurence & occurence) const
 		{
-			return CompressedString<CAPACITY>::EqualPrefix(VERTEX_SIZE, occurence.body_, body_);
+			return occurence.body_.GetKey() == body_.GetKey();
 		}
 
 		uint64_t Hash() const
 		{
-			return body_.HashPrefix(VERTEX_SIZE);
+			return body_.GetKey().Hash();
 		}
 
 		CompressedString<CAPACITY> GetBase() const
 		{
-			CompressedString<CAPACITY> ret;
-			ret.CopyPrefixFrom(body_, VERTEX_SIZE);
-			return ret;
+			return body_.GetKey();
 		}
 
 		bool operator < (const CandidateOccurence & other) const
 		{
-			return CompressedString<CAPACITY>::LessPrefix(body_, other.body_, VERTEX_SIZE);
+			return CompressedString<CAPACITY>::Less(body_.GetKey(), other.body_.GetKey());
 		}
-		
+
 	private:
-		char EncodeNmask(char next, char prev)
+		static uint8_t Encode(char next, char prev)
 		{
-			return DnaChar::LITERAL[(next == 'N' ? IS_NEXT_N : 0) | (prev == 'N' ? IS_PREV_N : 0)];
+			uint8_t ret = (next == 'N' ? IS_NEXT_N : 0) | (prev == 'N' ? IS_PREV_N : 0);
+			ret |= DnaChar::Code(next) << NEXT_SHIFT;
+			ret |= DnaChar::Code(prev) << PREV_SHIFT;
+			return ret;
 		}
 
-		CompressedString<CAPACITY> body_;
+		OccurenceBody<CAPACITY, PACKED> body_;
 	};
-
-
-	inline size_t CalculateNeededCapacity(size_t vertexLength)
-	{
-		size_t bufSize = vertexLength + CandidateOccurence<1>::ADDITIONAL_CHAR;
-		return bufSize / UNIT_CAPACITY + (bufSize % UNIT_CAPACITY == 0 ? 0 : 1);
-	}
 }
 
 #endif
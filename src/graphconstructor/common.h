@@ -3,6 +3,7 @@
 #define __STDC_LIMIT_MACROS
 
 #include <atomic>
+#include <string>
 #include <vector>
 #include <memory>
 #include <cstdint>
@@ -44,6 +45,21 @@ namespace TwoPaCo
 			seqId(seqId), start(start), piece(piece), isFinal(isFinal), str(std::move(str)) {}
 	};
 
+	//Key of an edge in the filter: the smaller of the edge and its reverse
+	//complement, 2 bits per character starting from the lowest bits
+	inline uint64_t CanonicalEdgeValue(const std::string & edge)
+	{
+		std::string revEdge = DnaChar::ReverseCompliment(edge);
+		const std::string & canonical = edge.compare(revEdge) > 0 ? revEdge : edge;
+		uint64_t ret = 0;
+		for (size_t i = 0; i < canonical.size(); i++)
+		{
+			ret += (DnaChar::MakeUpChar(canonical[i]) & 0x03) << (2 * i);
+		}
+
+		return ret;
+	}
+
 	typedef tbb::concurrent_bounded_queue<Task> TaskQueue;
 	typedef std::unique_ptr<TaskQueue> TaskQueuePtr;
 }
@@ -1,6 +0,0 @@
-#include "compressedstring.h"
-
-namespace TwoPaCo
-{
-	extern const size_t UNIT_CAPACITY = 32;
-}
\ No newline at end of file
@@ -1,22 +1,24 @@
 #ifndef _COMPRESSED_STRING_H_
 #define _COMPRESSED_STRING_H_
 
-#include <atomic>
 #include <string>
+#include <cstring>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 
 #include <dnachar.h>
-#include <spooky/SpookyV2.h>
 
 namespace TwoPaCo
 {
 	using std::min;
 	using std::max;
-	extern const size_t UNIT_CAPACITY;
+	//Characters packed into a word
+	const size_t UNIT_CAPACITY = 32;
 
+	//A plain array of packed words, 32 characters per word. It is trivially copyable,
+	//so keys can be copied, sorted and compared without atomic accesses.
 	template<size_t CAPACITY>
 	class CompressedString
 	{
@@ -36,24 +38,6 @@ namespace TwoPaCo
 			in.read(reinterpret_cast<char*>(str_), sizeof(str_[0]) * CAPACITY);
 		}
 
-		CompressedString(const CompressedString & toCopy)
-		{
-			for (size_t i = 0; i < CAPACITY; i++)
-			{
-				str_[i] = uint64_t(toCopy.str_[i]);
-			}
-		}
-
-		const CompressedString& operator = (const CompressedString & str)
-		{
-			for (size_t i = 0; i < CAPACITY; i++)
-			{
-				str_[i] = uint64_t(str.str_[i]);
-			}
-
-			return *this;
-		}
-
 		static uint64_t Mask(uint64_t prefix)
 		{
 			return (uint64_t(1) << (prefix * uint64_t(2))) - uint64_t(1);
@@ -149,7 +133,7 @@ namespace TwoPaCo
 
 		bool operator == (const CompressedString & other) const
 		{
-			return std::equal(str_, str_ + CAPACITY, other.str_);
+			return memcmp(str_, other.str_, sizeof(str_)) == 0;
 		}
 
 		bool operator != (const CompressedString & other) const
@@ -157,31 +141,57 @@ namespace TwoPaCo
 			return !(*this == other);
 		}
 
-		static char Id(char ch)
+		//Mixes the words one by one with a multiply-xorshift finalizer, the loop is
+		//unrolled since CAPACITY is known at compile time
+		uint64_t Hash() const
 		{
-			return ch;
+			uint64_t ret = 0;
+			for (size_t i = 0; i < CAPACITY; i++)
+			{
+				ret = MixWord(ret ^ str_[i] ^ (i * HASH_MULTIPLIER));
+			}
+
+			return ret;
 		}
 
-		uint64_t Hash() const
+		//Same as the hash of the string with all characters after the prefix cleared
+		uint64_t HashPrefix(size_t prefix) const
+		{
+			uint64_t ret = 0;
+			size_t full = prefix / UNIT_CAPACITY;
+			size_t partial = prefix % UNIT_CAPACITY;
+			for (size_t i = 0; i < CAPACITY; i++)
+			{
+				uint64_t piece = i < full ? str_[i] : (i == full && partial > 0 ? str_[i] & Mask(partial) : 0);
+				ret = MixWord(ret ^ piece ^ (i * HASH_MULTIPLIER));
+			}
+
+			return ret;
+		}
+
+		//Atomic accesses to a single word, for owners that keep their own bits in the
+		//unused high bits of the last word and update them concurrently
+		uint64_t LoadWord(size_t idx) const
 		{
-			return SpookyHash::Hash64(str_, sizeof(str_[0]) * CAPACITY, 0);
+			return __atomic_load_n(&str_[idx], __ATOMIC_RELAXED);
 		}
 
-		uint64_t HashPrefix(size_t prefix) const
+		void StoreWord(size_t idx, uint64_t value)
+		{
+			__atomic_store_n(&str_[idx], value, __ATOMIC_RELAXED);
+		}
+
+		void OrWord(size_t idx, uint64_t value)
 		{
-			CompressedString buf;
-			buf.CopyPrefixFrom(*this, prefix);
-			return SpookyHash::Hash64(buf.str_, sizeof(buf.str_[0]) * CAPACITY, 0);
+			__atomic_fetch_or(&str_[idx], value, __ATOMIC_RELAXED);
 		}
 
 		CompressedString ReverseComplement(size_t stringSize) const
 		{
 			CompressedString ret;
-			for (size_t i = 0; i < stringSize; i++)
-			{
-				ret.SetChar(i, DnaChar::ReverseChar(GetChar(stringSize - i - 1)));
-			}
-
+			CompressedString prefix;
+			prefix.CopyPrefixFrom(*this, stringSize);
+			DnaChar::ReverseComplementPacked(prefix.str_, stringSize, ret.str_);
 			return ret;
 		}
 
@@ -194,15 +204,6 @@ namespace TwoPaCo
 			str_[element] |= DnaChar::MakeUpChar(ch) << (2 * idx++);
 		}
 
-		void SetCharConcurrently(uint64_t idx, char ch) const
-		{
-			uint64_t element = TranslateIdx(idx);
-			uint64_t charIdx = str_[element] >> (2 * idx);
-			uint64_t mask = uint64_t(0x3) << (idx * 2);
-			const_cast<std::atomic<uint64_t>&>(str_[element]).fetch_and(~mask);
-			const_cast<std::atomic<uint64_t>&>(str_[element]).fetch_or(DnaChar::MakeUpChar(ch) << (2 * idx++));
-		}
-
 		char GetChar(uint64_t idx) const
 		{
 			uint64_t element = TranslateIdx(idx);
@@ -238,31 +239,37 @@ namespace TwoPaCo
 
 		void CopyFromString(std::string::const_iterator it, size_t size)
 		{
-			StrCpy(it, 0, 0, size, Id);
+			if (size > 0)
+			{
+				DnaChar::Pack(&*it, size, str_);
+			}
 		}
 
 		void CopyFromReverseString(std::string::const_iterator it, size_t size)
 		{
-			StrCpy(std::string::const_reverse_iterator(it + size), 0, 0, size, DnaChar::ReverseChar);
+			if (size > 0)
+			{
+				CompressedString buf;
+				DnaChar::Pack(&*it, size, buf.str_);
+				DnaChar::ReverseComplementPacked(buf.str_, size, str_);
+			}
 		}
 
 	private:
-		std::atomic<uint64_t> str_[CAPACITY];
+		static const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
 
-		template<class T, class F>
-		void StrCpy(T src, size_t element, size_t idx, size_t size, F f)
+		static uint64_t MixWord(uint64_t word)
 		{
-			for (size_t i = 0; i < size; i++)
-			{
-				str_[element] |= DnaChar::MakeUpChar(f(*src++)) << (2 * idx++);
-				if (idx >= UNIT_CAPACITY)
-				{
-					idx = 0;
-					++element;
-				}
-			}
+			word ^= word >> 33;
+			word *= 0xFF51AFD7ED558CCDULL;
+			word ^= word >> 33;
+			word *= 0xC4CEB9FE1A85EC53ULL;
+			word ^= word >> 33;
+			return word;
 		}
 
+		uint64_t str_[CAPACITY];
+
 		uint64_t TranslateIdx(uint64_t & idx) const
 		{
 			uint64_t ret = idx >> 5;
@@ -1,25 +1,119 @@
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
 #include "concurrentbitvector.h"
 
 namespace TwoPaCo
 {
+	namespace
+	{
+		//Reading stops at the end of the file, returns the number of bytes transferred
+		size_t TransferFile(const std::string & fileName, char * data, size_t size, bool write)
+		{
+			int fd = write ? open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) : open(fileName.c_str(), O_RDONLY);
+			if (fd == -1)
+			{
+				throw std::runtime_error("Can't open a temporary file");
+			}
+
+			size_t ret = 0;
+			while (ret < size)
+			{
+				ssize_t done = write ? ::write(fd, data + ret, size - ret) : ::read(fd, data + ret, size - ret);
+				if (done < 0 || (done == 0 && write))
+				{
+					close(fd);
+					throw std::runtime_error(write ? "Can't write to a temporary file" : "Can't read from a temporary file");
+				}
+
+				if (done == 0)
+				{
+					break;
+				}
+
+				ret += done;
+			}
+
+			close(fd);
+			return ret;
+		}
+	}
+
 	ConcurrentBitVector::ConcurrentBitVector(size_t size)
-		: size_(size), realSize_(size / 32 + 1), filter_(new UInt[realSize_])
+		: size_(size), realSize_(size / 64 + 1), mappedSize_(realSize_ * sizeof(BASIC_TYPE)), filter_(0)
 	{
-		Reset();
+		//Try the reserved huge pages first, then ask for transparent ones
+		void * data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (mappedSize_ >= HUGE_PAGE_SIZE)
+		{
+			size_t hugeSize = (mappedSize_ + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+			data = mmap(0, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (data != MAP_FAILED)
+			{
+				mappedSize_ = hugeSize;
+			}
+		}
+#endif
+		if (data == MAP_FAILED)
+		{
+			data = mmap(0, mappedSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (data == MAP_FAILED)
+			{
+				throw std::runtime_error("Can't allocate memory for a bit vector");
+			}
+#ifdef MADV_HUGEPAGE
+			madvise(data, mappedSize_, MADV_HUGEPAGE);
+#endif
+		}
+
+		//Anonymous pages are already zeroed
+		filter_ = static_cast<UInt*>(data);
 	}
 
-	void ConcurrentBitVector::Reset()
+	ConcurrentBitVector::ConcurrentBitVector(size_t size, const std::string & fileName)
+		: size_(size), realSize_(size / 64 + 1), mappedSize_(realSize_ * sizeof(BASIC_TYPE)), filter_(0)
 	{
-		for (size_t i = 0; i < realSize_; i++)
+		int fd = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd == -1)
 		{
-			filter_[i] = 0;
+			throw std::runtime_error("Can't open the bit vector file " + fileName);
 		}
+
+		struct stat st;
+		void * data = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && (size_t(st.st_size) >= mappedSize_ || ftruncate(fd, mappedSize_) == 0))
+		{
+			data = mmap(0, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+
+		close(fd);
+		if (data == MAP_FAILED)
+		{
+			throw std::runtime_error("Can't map the bit vector file " + fileName);
+		}
+
+		filter_ = static_cast<UInt*>(data);
+	}
+
+	void ConcurrentBitVector::Reset()
+	{
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, realSize_, PARALLEL_GRAIN), [this](const tbb::blocked_range<size_t> & range)
+		{
+			memset(static_cast<void*>(filter_ + range.begin()), 0, range.size() * sizeof(BASIC_TYPE));
+		});
 	}
 
 	size_t ConcurrentBitVector::Size() const
@@ -32,7 +126,7 @@ namespace TwoPaCo
 		uint64_t bit;
 		uint64_t element;
 		GetCoord(idx, element, bit);
-		filter_[element].fetch_or(uint32_t(1) << uint32_t(bit));
+		filter_[element].fetch_or(BASIC_TYPE(1) << bit);
 	}
 
 	bool ConcurrentBitVector::GetBit(size_t idx) const
@@ -40,48 +134,32 @@ namespace TwoPaCo
 		uint64_t bit;
 		uint64_t element;
 		GetCoord(idx, element, bit);
-		return (filter_[element] & (uint32_t(1) << uint32_t(bit))) != 0;
+		return (filter_[element].load(std::memory_order_relaxed) & (BASIC_TYPE(1) << bit)) != 0;
 	}
 
 	void ConcurrentBitVector::GetCoord(uint64_t idx, uint64_t & element, uint64_t & bit) const
 	{
-		bit = idx & ((uint32_t(1) << uint64_t(5)) - 1);
-		element = idx >> 5;
-		assert(element < size_ / 32 + 1);
+		bit = idx & 63;
+		element = idx >> 6;
+		assert(element < realSize_);
 	}
 
 	ConcurrentBitVector::~ConcurrentBitVector()
 	{
-		delete[] filter_;
+		munmap(static_cast<void*>(filter_), mappedSize_);
 	}
 
 	void ConcurrentBitVector::WriteToFile(const std::string & fileName) const
 	{
-		std::ofstream candidateMaskFile(fileName.c_str(), std::ios::binary);
-		if (!candidateMaskFile)
-		{
-			throw std::runtime_error("Can't open a temporary file");
-		}
-
-		if (!candidateMaskFile.write(reinterpret_cast<const char*>(filter_), realSize_ * sizeof(BASIC_TYPE)))
-		{
-			throw std::runtime_error("Can't write to a temporary file");
-		}
+		TransferFile(fileName, reinterpret_cast<char*>(filter_), realSize_ * sizeof(BASIC_TYPE), true);
 	}
 
 	void ConcurrentBitVector::ReadFromFile(const std::string & fileName, bool cleanUp)
 	{
+		//Files written with 32-bit words may be a few bytes shorter
+		if (TransferFile(fileName, reinterpret_cast<char*>(filter_), realSize_ * sizeof(BASIC_TYPE), false) < (size_ + 7) / 8)
 		{
-			std::ifstream candidateMaskFile(fileName.c_str(), std::ios::binary);
-			if (!candidateMaskFile)
-			{
-				throw std::runtime_error("Can't open a temporary file");
-			}
-
-			if (!candidateMaskFile.read(reinterpret_cast<char*>(filter_), realSize_ * sizeof(BASIC_TYPE)))
-			{
-				throw std::runtime_error("Can't read from a temporary file");
-			}
+			throw std::runtime_error("Can't read from a temporary file");
 		}
 
 		if (cleanUp)
@@ -92,9 +170,12 @@ namespace TwoPaCo
 
 	void ConcurrentBitVector::MergeOr(const ConcurrentBitVector & mask)
 	{
-		for (size_t i = 0; i < realSize_; i++)
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, realSize_, PARALLEL_GRAIN), [this, &mask](const tbb::blocked_range<size_t> & range)
 		{
-			filter_[i] |= mask.filter_[i];
-		}
+			for (size_t i = range.begin(); i != range.end(); i++)
+			{
+				filter_[i].fetch_or(mask.filter_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+		});
 	}
 }
@@ -4,16 +4,23 @@
 #include <cstdlib>
 #include <vector>
 #include <atomic>
+#include <string>
 
 #include "common.h"
 
 namespace TwoPaCo
 {
+	//A bit vector of 64-bit atomic words. The words are mapped with mmap: anonymous
+	//memory backed by huge pages if possible, or a file, so the vector can be
+	//persisted and reloaded without copying. The bits are laid out the same way
+	//as in an array of 32-bit words on little-endian machines.
 	class ConcurrentBitVector
 	{
 	public:
 		~ConcurrentBitVector();
 		ConcurrentBitVector(size_t size);
+		//Maps the file, it is created if doesn't exist. Changes are written to the file.
+		ConcurrentBitVector(size_t size, const std::string & fileName);
 		void Reset();
 		size_t Size() const;
 		void SetBitConcurrently(size_t idx);
@@ -24,14 +31,17 @@ namespace TwoPaCo
 	private:
 		DISALLOW_COPY_AND_ASSIGN(ConcurrentBitVector);
 		static const size_t SUCCESS = -1;
-		typedef uint32_t BASIC_TYPE;
+		static const size_t HUGE_PAGE_SIZE = size_t(1) << 21;
+		static const size_t PARALLEL_GRAIN = size_t(1) << 16;
+		typedef uint64_t BASIC_TYPE;
 		typedef std::atomic<BASIC_TYPE> UInt;
 		size_t size_;
 		size_t realSize_;
+		size_t mappedSize_;
 		UInt * filter_;
 		void GetCoord(uint64_t idx, uint64_t & element, uint64_t & bit) const;
-	};	
+	};
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -16,6 +16,7 @@
 #include <tclap/CmdLine.h>
 
 #include "test.h"
+#include "twopaco.h"
 #include "assemblyedgeconstructor.h"
 
 size_t Atoi(const char * str)
@@ -57,11 +58,10 @@ int main(int argc, char * argv[])
 	{
 		TCLAP::CmdLine cmd("Program for construction of the condensed de Bruijn graph from complete genomes", ' ', "0.9.2");
 		
-		TCLAP::ValueArg<unsigned int> kvalue("k",
+		TCLAP::MultiArg<unsigned int> kvalue("k",
 			"kvalue",
-			"Value of k",
+			"Value of k, when given several times the graphs for all the values are built in one pass over the input",
 			false,
-			25,
 			&constraint,
 			cmd);
 
@@ -124,6 +124,64 @@ int main(int argc, char * argv[])
 			"file name",
 			cmd);
 
+		TCLAP::ValueArg<std::string> metricsFileName("",
+			"metrics",
+			"Write per-stage timings and counters to this file in JSON",
+			false,
+			"",
+			"file name",
+			cmd);
+
+		TCLAP::ValueArg<std::string> traceFileName("",
+			"trace",
+			"Write a timeline of the stages and worker tasks to this file in Chrome trace format",
+			false,
+			"",
+			"file name",
+			cmd);
+
+		TCLAP::ValueArg<double> progressInterval("",
+			"progress",
+			"Report the progress of the current pass every this many seconds",
+			false,
+			10,
+			"seconds",
+			cmd);
+
+		TCLAP::ValueArg<std::string> statusFileName("",
+			"status",
+			"Rewrite this file with the progress report instead of printing it",
+			false,
+			"",
+			"file name",
+			cmd);
+
+		TCLAP::ValueArg<std::string> extendFileName("",
+			"extend",
+			"Add the input genomes to the graph in this file, which must be built with --extendable",
+			false,
+			"",
+			"file name",
+			cmd);
+
+		TCLAP::SwitchArg extendable("",
+			"extendable",
+			"Save the edge filter and the junctions, so the graph can be extended later",
+			cmd);
+
+		TCLAP::ValueArg<std::string> cacheDirName("",
+			"cache",
+			"Keep the outputs of the stages in this directory and reuse the ones left by a previous run on the same input",
+			false,
+			"",
+			"directory name",
+			cmd);
+
+		TCLAP::SwitchArg membership("",
+			"membership",
+			"Write the genomes (input files) containing every junction to <output file>.membership",
+			cmd);
+
 		cmd.parse(argc, argv);		
 		using TwoPaCo::Range;
 		if (runTests.getValue())
@@ -132,19 +190,89 @@ int main(int argc, char * argv[])
 			return 0;
 		}
 		
-		std::unique_ptr<TwoPaCo::VertexEnumerator> vid = TwoPaCo::CreateEnumerator(fileName.getValue(),
-			kvalue.getValue(), filterSize.getValue(),
-			hashFunctions.getValue(),
-			rounds.getValue(),
-			threads.getValue(),
-			tmpDirName.getValue(),
-			outFileName.getValue(),
-			std::cout);
+		if (traceFileName.isSet())
+		{
+			TwoPaCo::Tracer::Enable();
+		}
+
+		if (progressInterval.isSet() || statusFileName.isSet())
+		{
+			TwoPaCo::Progress::Enable(progressInterval.getValue(), statusFileName.getValue(), fileName.getValue());
+		}
+
+		std::vector<size_t> vertexLength(kvalue.getValue().begin(), kvalue.getValue().end());
+		if (vertexLength.empty())
+		{
+			vertexLength.push_back(25);
+		}
+
+		TwoPaCo::Options options;
+		options.vertexLength = vertexLength[0];
+		options.filterSize = filterSize.getValue();
+		options.hashFunctions = hashFunctions.getValue();
+		options.rounds = rounds.getValue();
+		options.threads = threads.getValue();
+		options.tmpDirName = tmpDirName.getValue();
+		options.outFileName = outFileName.getValue();
+		options.extendFileName = extendFileName.getValue();
+		options.extendable = extendable.getValue();
+		options.cacheDirName = cacheDirName.getValue();
+		options.membership = membership.getValue();
+		std::vector<std::unique_ptr<TwoPaCo::VertexEnumerator> > vid;
+		if (vertexLength.size() == 1)
+		{
+			vid.push_back(TwoPaCo::BuildGraph(fileName.getValue(), options, TwoPaCo::JunctionCallback(), std::cout));
+		}
+		else
+		{
+			std::vector<std::stringstream> log(vertexLength.size());
+			std::vector<std::ostream*> logStream;
+			for (std::stringstream & ss : log)
+			{
+				logStream.push_back(&ss);
+			}
+
+			vid = TwoPaCo::BuildGraphs(fileName.getValue(), vertexLength, options, logStream);
+			for (size_t i = 0; i < vertexLength.size(); i++)
+			{
+				std::cout << "K = " << vertexLength[i] << std::endl << log[i].str();
+			}
+		}
 		
-		if (vid)
+		TwoPaCo::Progress::Disable();
+		for (size_t i = 0; i < vid.size(); i++)
+		{
+			if (vid[i])
+			{
+				if (vid.size() > 1)
+				{
+					std::cout << "K = " << vertexLength[i] << ", ";
+				}
+
+				std::cout << "Distinct junctions = " << vid[i]->GetVerticesCount() << std::endl;
+				std::cout << std::endl;
+			}
+
+			if (vid[i] && metricsFileName.isSet())
+			{
+				std::string metricsName = vid.size() > 1 ? TwoPaCo::KFileName(metricsFileName.getValue(), vertexLength[i]) : metricsFileName.getValue();
+				std::ofstream metricsFile(metricsName.c_str());
+				vid[i]->GetMetrics().WriteJson(metricsFile);
+				if (!metricsFile)
+				{
+					throw std::runtime_error("Can't write the metrics file");
+				}
+			}
+		}
+
+		if (traceFileName.isSet())
 		{
-			std::cout << "Distinct junctions = " << vid->GetVerticesCount() << std::endl;
-			std::cout << std::endl;
+			std::ofstream traceFile(traceFileName.getValue().c_str());
+			TwoPaCo::Tracer::WriteJson(traceFile);
+			if (!traceFile)
+			{
+				throw std::runtime_error("Can't write the trace file");
+			}
 		}
 		
 	}
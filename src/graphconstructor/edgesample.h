@@ -0,0 +1,59 @@
+#ifndef _EDGE_SAMPLE_H_
+#define _EDGE_SAMPLE_H_
+
+#include <cstdint>
+
+#include <tbb/concurrent_unordered_set.h>
+
+#include "common.h"
+
+namespace TwoPaCo
+{
+	//Exact set of a small fraction of the edges inserted into the edge filter. The
+	//fraction is chosen by a hash of the edge, so the same edges are sampled when the
+	//filter is queried and the false positive rate can be measured on the sampled
+	//queries of edges that were never inserted.
+	class EdgeSample
+	{
+	public:
+		static const uint64_t SAMPLE_RATE = 256;
+
+		EdgeSample()
+		{
+
+		}
+
+		static bool Sampled(uint64_t edgeVal)
+		{
+			//The finalizer of MurmurHash3, the filter keys themselves are not uniform
+			edgeVal ^= edgeVal >> 33;
+			edgeVal *= 0xff51afd7ed558ccdULL;
+			edgeVal ^= edgeVal >> 33;
+			edgeVal *= 0xc4ceb9fe1a85ec53ULL;
+			edgeVal ^= edgeVal >> 33;
+			return edgeVal % SAMPLE_RATE == 0;
+		}
+
+		//Can be called concurrently
+		void Add(uint64_t edgeVal)
+		{
+			edge_.insert(edgeVal);
+		}
+
+		bool Contains(uint64_t edgeVal) const
+		{
+			return edge_.count(edgeVal) > 0;
+		}
+
+		uint64_t Size() const
+		{
+			return edge_.size();
+		}
+
+	private:
+		DISALLOW_COPY_AND_ASSIGN(EdgeSample);
+		tbb::concurrent_unordered_set<uint64_t> edge_;
+	};
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef _MEMBERSHIP_TABLE_H_
+#define _MEMBERSHIP_TABLE_H_
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+
+#include <unistd.h>
+#include <tbb/mutex.h>
+
+#include <junctionapi/junctionmembership.h>
+
+#include "common.h"
+
+namespace TwoPaCo
+{
+	//The rows of the membership file built in memory during the edge construction. A
+	//worker collects the (junction, genome) pairs it meets in its own Buffer, which is
+	//sorted, deduplicated and merged into the rows once it fills up. The merge locks one
+	//range of RANGE_SIZE junctions at a time, so the workers only contend when they merge
+	//into the same range and the repeats of a junction within a buffer cost nothing
+	class MembershipTable
+	{
+	public:
+		static const uint64_t RANGE_SIZE = 1 << 12;
+		static const size_t BUFFER_SIZE = 1 << 16;
+
+		class Buffer
+		{
+		public:
+			Buffer(MembershipTable & table) : table_(table)
+			{
+
+			}
+
+			~Buffer()
+			{
+				Flush();
+			}
+
+			//The id is the one of the junctions file, the stubs are skipped
+			void Add(int64_t id, uint32_t record)
+			{
+				uint64_t junction = std::llabs(id);
+				if (junction > 0 && junction <= table_.junctions_)
+				{
+					pair_.push_back(std::make_pair(junction - 1, table_.genome_[record]));
+					if (pair_.size() >= BUFFER_SIZE)
+					{
+						Flush();
+					}
+				}
+			}
+
+			void Flush()
+			{
+				std::sort(pair_.begin(), pair_.end());
+				pair_.erase(std::unique(pair_.begin(), pair_.end()), pair_.end());
+				for (auto it = pair_.begin(); it != pair_.end();)
+				{
+					uint64_t range = it->first / RANGE_SIZE;
+					table_.mutex_[range].lock();
+					for (; it != pair_.end() && it->first / RANGE_SIZE == range; ++it)
+					{
+						table_.row_[it->first * table_.rowBytes_ + it->second / 8] |= char(1 << (it->second % 8));
+					}
+
+					table_.mutex_[range].unlock();
+				}
+
+				pair_.clear();
+			}
+
+		private:
+			DISALLOW_COPY_AND_ASSIGN(Buffer);
+			MembershipTable & table_;
+			std::vector<std::pair<uint64_t, uint32_t> > pair_;
+		};
+
+		//The genome of every record, as numbered by SequenceManifest::GetGenomes
+		MembershipTable(uint64_t junctions, const std::vector<uint32_t> & genome, uint64_t genomes) :
+			junctions_(junctions),
+			genomes_(genomes),
+			rowBytes_(JunctionMembershipReader::RowBytes(genomes)),
+			genome_(genome),
+			row_(junctions * rowBytes_, 0),
+			mutex_(new tbb::mutex[(junctions + RANGE_SIZE - 1) / RANGE_SIZE])
+		{
+
+		}
+
+		static uint64_t GetBytes(uint64_t junctions, uint64_t genomes)
+		{
+			return junctions * JunctionMembershipReader::RowBytes(genomes);
+		}
+
+		//The rows are kept in memory along with the junction storage and the edge
+		//results, so they may take at most half of the physical memory
+		static uint64_t GetLimit()
+		{
+			long pages = sysconf(_SC_PHYS_PAGES);
+			long pageSize = sysconf(_SC_PAGE_SIZE);
+			return pages > 0 && pageSize > 0 ? uint64_t(pages) * uint64_t(pageSize) / 2 : UINT64_MAX;
+		}
+
+		uint64_t GetBytes() const
+		{
+			return row_.size();
+		}
+
+		uint64_t WriteToFile(const std::string & fileName) const
+		{
+			std::ofstream out(fileName.c_str(), std::ios::binary);
+			out.write(reinterpret_cast<const char*>(&junctions_), sizeof(junctions_));
+			out.write(reinterpret_cast<const char*>(&genomes_), sizeof(genomes_));
+			out.write(row_.data(), row_.size());
+			if (!out)
+			{
+				throw std::runtime_error("Can't write the membership file");
+			}
+
+			return JunctionMembershipReader::HeaderBytes() + row_.size();
+		}
+
+	private:
+		DISALLOW_COPY_AND_ASSIGN(MembershipTable);
+		uint64_t junctions_;
+		uint64_t genomes_;
+		uint64_t rowBytes_;
+		std::vector<uint32_t> genome_;
+		std::vector<char> row_;
+		std::unique_ptr<tbb::mutex[]> mutex_;
+	};
+}
+
+#endif
@@ -0,0 +1,431 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <sys/resource.h>
+
+#include "tracer.h"
+#include "metrics.h"
+#include "progress.h"
+
+namespace TwoPaCo
+{
+	Metrics::Metrics() : stageStarted_(false), progress_(true), workers_(1), traceStart_(0), cpuStart_(0)
+	{
+		for (size_t i = 0; i < COUNTERS_COUNT; i++)
+		{
+			counter_[i] = 0;
+		}
+
+		for (size_t i = 0; i < MEMORY_COUNT; i++)
+		{
+			memory_[i] = 0;
+			memoryPeak_[i] = 0;
+		}
+	}
+
+	const char * Metrics::CounterName(CounterId id)
+	{
+		static const char * name[] =
+		{
+			"input_bases",
+			"filter_inserts",
+			"filter_probes",
+			"candidate_marks",
+			"hash_table_inserts",
+			"hash_table_size",
+			"hash_table_probes",
+			"true_junctions",
+			"false_junctions",
+			"junction_occurences",
+			"temp_files_written",
+			"temp_files_read",
+			"temp_bytes_written",
+			"output_bytes_written",
+			"temp_io_microseconds",
+			"queue_stalls",
+			"sampled_edges",
+			"sampled_probes",
+			"sampled_negatives",
+			"sampled_false_positives",
+			"producer_blocked_microseconds",
+			"worker_idle_microseconds",
+			"queue_below_25_percent",
+			"queue_below_50_percent",
+			"queue_below_75_percent",
+			"queue_below_full",
+			"queue_full"
+		};
+
+		static_assert(sizeof(name) / sizeof(name[0]) == COUNTERS_COUNT, "Each counter must have a name");
+		return name[id];
+	}
+
+	const char * Metrics::MemoryName(MemoryId id)
+	{
+		static const char * name[] =
+		{
+			"edge_filter",
+			"occurence_set",
+			"storage_keys",
+			"storage_filter",
+			"task_queues",
+			"edge_results",
+			"membership"
+		};
+
+		static_assert(sizeof(name) / sizeof(name[0]) == MEMORY_COUNT, "Each memory gauge must have a name");
+		return name[id];
+	}
+
+	void Metrics::UpdatePeak(MemoryId id, uint64_t bytes)
+	{
+		uint64_t peak = memoryPeak_[id].load(std::memory_order_relaxed);
+		while (bytes > peak && !memoryPeak_[id].compare_exchange_weak(peak, bytes, std::memory_order_relaxed));
+	}
+
+	void Metrics::SetMemory(MemoryId id, uint64_t bytes)
+	{
+		memory_[id].store(bytes, std::memory_order_relaxed);
+		UpdatePeak(id, bytes);
+	}
+
+	void Metrics::AddMemory(MemoryId id, int64_t bytes)
+	{
+		int64_t now = memory_[id].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		UpdatePeak(id, max(now, int64_t(0)));
+	}
+
+	uint64_t Metrics::PeakRss()
+	{
+		std::string line;
+		std::ifstream status("/proc/self/status");
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmHWM:") == 0)
+			{
+				return uint64_t(atoll(line.c_str() + 6)) * 1024;
+			}
+		}
+
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return uint64_t(usage.ru_maxrss) * 1024;
+	}
+
+	//Resets the peak of the resident set to the current size where the kernel allows it,
+	//otherwise the peak of a stage is the peak of the process so far
+	void Metrics::ResetPeakRss()
+	{
+		std::ofstream clearRefs("/proc/self/clear_refs");
+		clearRefs << "5";
+	}
+
+	void Metrics::SetParameter(const std::string & name, uint64_t value)
+	{
+		std::stringstream ss;
+		ss << value;
+		parameter_.push_back(std::make_pair(name, ss.str()));
+	}
+
+	void Metrics::SetParameter(const std::string & name, const std::string & value)
+	{
+		parameter_.push_back(std::make_pair(name, Quote(value)));
+	}
+
+	void Metrics::SetParameter(const std::string & name, const std::vector<std::string> & value)
+	{
+		std::string list = "[";
+		for (size_t i = 0; i < value.size(); i++)
+		{
+			list += (i > 0 ? ", " : "") + Quote(value[i]);
+		}
+
+		parameter_.push_back(std::make_pair(name, list + "]"));
+	}
+
+	void Metrics::Add(const Counters & counters)
+	{
+		for (size_t i = 0; i < COUNTERS_COUNT; i++)
+		{
+			uint64_t value = counters.Get(CounterId(i));
+			if (value > 0)
+			{
+				counter_[i].fetch_add(value, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void Metrics::Add(CounterId id, uint64_t value)
+	{
+		counter_[id].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	uint64_t Metrics::Get(CounterId id) const
+	{
+		return counter_[id].load(std::memory_order_relaxed);
+	}
+
+	void Metrics::StartStage(const std::string & name, int64_t round)
+	{
+		if (stageStarted_)
+		{
+			FinishStage();
+		}
+
+		stageStarted_ = true;
+		current_.name = name;
+		current_.round = round;
+		for (size_t i = 0; i < COUNTERS_COUNT; i++)
+		{
+			current_.counter[i] = Get(CounterId(i));
+		}
+
+		for (size_t i = 0; i < MEMORY_COUNT; i++)
+		{
+			memoryPeak_[i] = max(memory_[i].load(), int64_t(0));
+		}
+
+		ResetPeakRss();
+		traceStart_ = Tracer::Now();
+		cpuStart_ = std::clock();
+		wallStart_ = std::chrono::steady_clock::now();
+		if (progress_)
+		{
+			Progress::StartStage(name, round);
+		}
+	}
+
+	double Metrics::FinishStage()
+	{
+		if (!stageStarted_)
+		{
+			return 0;
+		}
+
+		stageStarted_ = false;
+		current_.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart_).count();
+		current_.cpuTime = double(std::clock() - cpuStart_) / CLOCKS_PER_SEC;
+		for (size_t i = 0; i < COUNTERS_COUNT; i++)
+		{
+			current_.counter[i] = Get(CounterId(i)) - current_.counter[i];
+		}
+
+		for (size_t i = 0; i < MEMORY_COUNT; i++)
+		{
+			current_.memory[i] = memoryPeak_[i];
+		}
+
+		current_.peakRss = PeakRss();
+
+		if (Tracer::Enabled())
+		{
+			std::stringstream name;
+			name << "stage " << current_.name;
+			if (current_.round >= 0)
+			{
+				name << ", round " << current_.round;
+			}
+
+			Tracer::Record(name.str(), traceStart_, Tracer::Now());
+		}
+
+		stage_.push_back(current_);
+		return current_.wallTime;
+	}
+
+	uint64_t Metrics::GetLastStage(CounterId id) const
+	{
+		return stage_.empty() ? 0 : stage_.back().counter[id];
+	}
+
+	std::string Metrics::Quote(const std::string & str)
+	{
+		std::string ret = "\"";
+		for (char ch : str)
+		{
+			if (ch == '"' || ch == '\\')
+			{
+				ret.push_back('\\');
+				ret.push_back(ch);
+			}
+			else if (uint8_t(ch) < 0x20)
+			{
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", int(ch));
+				ret += buf;
+			}
+			else
+			{
+				ret.push_back(ch);
+			}
+		}
+
+		return ret + "\"";
+	}
+
+	void Metrics::WriteRecord(std::ostream & out, const Stage & stage, const std::string & indent)
+	{
+		out << "{" << std::endl;
+		if (!stage.name.empty())
+		{
+			out << indent << "\t\"name\": " << Quote(stage.name) << "," << std::endl;
+		}
+
+		if (stage.round >= 0)
+		{
+			out << indent << "\t\"round\": " << stage.round << "," << std::endl;
+		}
+
+		out << indent << "\t\"wall_seconds\": " << stage.wallTime << "," << std::endl;
+		out << indent << "\t\"cpu_seconds\": " << stage.cpuTime;
+		for (size_t i = 0; i < COUNTERS_COUNT; i++)
+		{
+			out << "," << std::endl << indent << "\t\"" << CounterName(CounterId(i)) << "\": " << stage.counter[i];
+		}
+
+		out << "," << std::endl << indent << "\t\"peak_rss_bytes\": " << stage.peakRss;
+		for (size_t i = 0; i < MEMORY_COUNT; i++)
+		{
+			out << "," << std::endl << indent << "\t\"peak_" << MemoryName(MemoryId(i)) << "_bytes\": " << stage.memory[i];
+		}
+
+		out << std::endl << indent << "}";
+	}
+
+	void Metrics::WriteJson(std::ostream & out) const
+	{
+		Stage total;
+		total.round = -1;
+		total.wallTime = total.cpuTime = 0;
+		total.peakRss = 0;
+		std::fill(total.memory, total.memory + MEMORY_COUNT, uint64_t(0));
+		for (const Stage & stage : stage_)
+		{
+			total.wallTime += stage.wallTime;
+			total.cpuTime += stage.cpuTime;
+			total.peakRss = max(total.peakRss, stage.peakRss);
+			for (size_t i = 0; i < MEMORY_COUNT; i++)
+			{
+				total.memory[i] = max(total.memory[i], stage.memory[i]);
+			}
+		}
+
+		for (size_t i = 0; i < COUNTERS_COUNT; i++)
+		{
+			total.counter[i] = Get(CounterId(i));
+		}
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision(6);
+		out << "{" << std::endl << "\t\"parameters\": {";
+		for (size_t i = 0; i < parameter_.size(); i++)
+		{
+			out << (i > 0 ? "," : "") << std::endl << "\t\t" << Quote(parameter_[i].first) << ": " << parameter_[i].second;
+		}
+
+		out << std::endl << "\t}," << std::endl << "\t\"total\": ";
+		WriteRecord(out, total, "\t");
+		out << "," << std::endl << "\t\"stages\": [";
+		for (size_t i = 0; i < stage_.size(); i++)
+		{
+			out << (i > 0 ? ", " : "") << std::endl << "\t\t";
+			WriteRecord(out, stage_[i], "\t\t");
+		}
+
+		out << std::endl << "\t]" << std::endl << "}" << std::endl;
+		out.flags(flags);
+	}
+
+	void Metrics::WriteMemoryTable(std::ostream & out) const
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision(1) << "Peak memory, MB" << std::endl << "Stage\tRound\trss";
+		for (size_t i = 0; i < MEMORY_COUNT; i++)
+		{
+			out << "\t" << MemoryName(MemoryId(i));
+		}
+
+		out << std::endl;
+		for (const Stage & stage : stage_)
+		{
+			out << stage.name << "\t";
+			if (stage.round >= 0)
+			{
+				out << stage.round;
+			}
+
+			out << "\t" << stage.peakRss / double(1 << 20);
+			for (size_t i = 0; i < MEMORY_COUNT; i++)
+			{
+				out << "\t" << stage.memory[i] / double(1 << 20);
+			}
+
+			out << std::endl;
+		}
+
+		out.flags(flags);
+	}
+
+	void Metrics::SetProgress(bool enabled)
+	{
+		progress_ = enabled;
+	}
+
+	void Metrics::SetWorkers(size_t workers)
+	{
+		workers_ = max(workers, size_t(1));
+	}
+
+	//Whichever side waits for the other for a noticeable share of the time
+	const char * Metrics::Verdict(double producerBlocked, double workersIdle)
+	{
+		const double NOTICEABLE = 0.1;
+		if (max(producerBlocked, workersIdle) < NOTICEABLE)
+		{
+			return "balanced";
+		}
+
+		return producerBlocked > workersIdle ? "worker-bound" : "producer-bound";
+	}
+
+	void Metrics::WritePipelineTable(std::ostream & out) const
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision(1) << "Pipeline, % of the stage time and of the queue samples" << std::endl
+			<< "Stage\tRound\tBlocked\tIdle\t<25%\t<50%\t<75%\t<Full\tFull\tVerdict" << std::endl;
+		for (const Stage & stage : stage_)
+		{
+			uint64_t samples = 0;
+			for (size_t i = QUEUE_BELOW_25_PERCENT; i <= QUEUE_FULL; i++)
+			{
+				samples += stage.counter[i];
+			}
+
+			if (samples == 0 || stage.wallTime <= 0)
+			{
+				continue;
+			}
+
+			double producerBlocked = stage.counter[PRODUCER_BLOCKED_MICROSECONDS] / 1e6 / stage.wallTime;
+			double workersIdle = stage.counter[WORKER_IDLE_MICROSECONDS] / 1e6 / stage.wallTime / workers_;
+			out << stage.name << "\t";
+			if (stage.round >= 0)
+			{
+				out << stage.round;
+			}
+
+			out << "\t" << 100 * producerBlocked << "\t" << 100 * workersIdle;
+			for (size_t i = QUEUE_BELOW_25_PERCENT; i <= QUEUE_FULL; i++)
+			{
+				out << "\t" << 100.0 * stage.counter[i] / samples;
+			}
+
+			out << "\t" << Verdict(producerBlocked, workersIdle) << std::endl;
+		}
+
+		out.flags(flags);
+	}
+}
@@ -0,0 +1,228 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <ctime>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+#include "common.h"
+#include "progress.h"
+
+namespace TwoPaCo
+{
+	//Statistics of the construction: wall and CPU time of every stage and the
+	//counters accumulated during it. Each worker counts into its own Counters and
+	//adds them to the shared atomic ones once it finishes a stage. The bytes held
+	//by the large data structures are tracked as gauges, every stage records
+	//their peaks and the peak resident set size of the process.
+	class Metrics
+	{
+	public:
+		enum CounterId
+		{
+			INPUT_BASES,
+			FILTER_INSERTS,
+			FILTER_PROBES,
+			CANDIDATE_MARKS,
+			HASH_TABLE_INSERTS,
+			HASH_TABLE_SIZE,
+			HASH_TABLE_PROBES,
+			TRUE_JUNCTIONS,
+			FALSE_JUNCTIONS,
+			JUNCTION_OCCURENCES,
+			TEMP_FILES_WRITTEN,
+			TEMP_FILES_READ,
+			TEMP_BYTES_WRITTEN,
+			OUTPUT_BYTES_WRITTEN,
+			TEMP_IO_MICROSECONDS,
+			QUEUE_STALLS,
+			//Exact checks of the edge filter on a hash-selected sample of the edges
+			SAMPLED_EDGES,
+			SAMPLED_PROBES,
+			SAMPLED_NEGATIVES,
+			SAMPLED_FALSE_POSITIVES,
+			PRODUCER_BLOCKED_MICROSECONDS,
+			WORKER_IDLE_MICROSECONDS,
+			//Occupancy of the queues sampled by the producer at every task
+			QUEUE_BELOW_25_PERCENT,
+			QUEUE_BELOW_50_PERCENT,
+			QUEUE_BELOW_75_PERCENT,
+			QUEUE_BELOW_FULL,
+			QUEUE_FULL,
+			COUNTERS_COUNT
+		};
+
+		enum MemoryId
+		{
+			EDGE_FILTER,
+			OCCURENCE_SET,
+			STORAGE_KEYS,
+			STORAGE_FILTER,
+			TASK_QUEUES,
+			EDGE_RESULTS,
+			MEMBERSHIP,
+			MEMORY_COUNT
+		};
+
+		class Counters
+		{
+		public:
+			Counters()
+			{
+				std::fill(value_, value_ + COUNTERS_COUNT, uint64_t(0));
+			}
+
+			void Add(CounterId id, uint64_t value = 1)
+			{
+				value_[id] += value;
+			}
+
+			uint64_t Get(CounterId id) const
+			{
+				return value_[id];
+			}
+
+			void AddQueueSample(size_t size, size_t capacity)
+			{
+				value_[QUEUE_BELOW_25_PERCENT + min(size * 4 / capacity, size_t(4))]++;
+			}
+
+		private:
+			uint64_t value_[COUNTERS_COUNT];
+		};
+
+		//Measures the time elapsed since its creation
+		class Timer
+		{
+		public:
+			Timer() : start_(std::chrono::steady_clock::now())
+			{
+
+			}
+
+			uint64_t Microseconds() const
+			{
+				return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count();
+			}
+
+		private:
+			std::chrono::steady_clock::time_point start_;
+		};
+
+		//Accumulates the time a worker spends polling its empty queue
+		class IdleTimer
+		{
+		public:
+			IdleTimer(Counters & counters) : idle_(false), counters_(counters)
+			{
+
+			}
+
+			void Idle()
+			{
+				if (!idle_)
+				{
+					idle_ = true;
+					start_ = std::chrono::steady_clock::now();
+				}
+			}
+
+			void Busy()
+			{
+				if (idle_)
+				{
+					idle_ = false;
+					counters_.Add(WORKER_IDLE_MICROSECONDS, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count());
+				}
+			}
+
+		private:
+			bool idle_;
+			Counters & counters_;
+			std::chrono::steady_clock::time_point start_;
+		};
+
+		Metrics();
+		static const char * CounterName(CounterId id);
+		void SetParameter(const std::string & name, uint64_t value);
+		void SetParameter(const std::string & name, const std::string & value);
+		void SetParameter(const std::string & name, const std::vector<std::string> & value);
+		//Can be called concurrently
+		void Add(const Counters & counters);
+		void Add(CounterId id, uint64_t value);
+		uint64_t Get(CounterId id) const;
+		static const char * MemoryName(MemoryId id);
+		//Can be called concurrently, the peak of the current stage is updated
+		void SetMemory(MemoryId id, uint64_t bytes);
+		void AddMemory(MemoryId id, int64_t bytes);
+		//A stage lasts until the next one starts or FinishStage is called, round is
+		//the number of the computational round or -1 if the stage is not a part of one
+		void StartStage(const std::string & name, int64_t round = -1);
+		//Returns the wall time of the stage in seconds, the stage is also added to the trace
+		double FinishStage();
+		//When several graphs are built at once only one of them reports the progress
+		void SetProgress(bool enabled);
+		bool ReportsProgress() const
+		{
+			return progress_;
+		}
+
+		//Called by the workers for every task they take
+		void AddProgress(uint64_t bases)
+		{
+			if (progress_)
+			{
+				Progress::AddBases(bases);
+			}
+		}
+
+		//Counter value accumulated during the last finished stage
+		uint64_t GetLastStage(CounterId id) const;
+		void WriteJson(std::ostream & out) const;
+		//Peak memory of every stage in megabytes, one line per stage
+		void WriteMemoryTable(std::ostream & out) const;
+		//The number of workers consuming the queues, used to judge the pipeline
+		void SetWorkers(size_t workers);
+		//Producer blocked and worker idle time, queue occupancy and the verdict of
+		//every stage that read the input, one line per stage
+		void WritePipelineTable(std::ostream & out) const;
+
+	private:
+		DISALLOW_COPY_AND_ASSIGN(Metrics);
+		struct Stage
+		{
+			std::string name;
+			int64_t round;
+			double wallTime;
+			double cpuTime;
+			uint64_t counter[COUNTERS_COUNT];
+			uint64_t peakRss;
+			uint64_t memory[MEMORY_COUNT];
+		};
+
+		static std::string Quote(const std::string & str);
+		static void WriteRecord(std::ostream & out, const Stage & stage, const std::string & indent);
+		static const char * Verdict(double producerBlocked, double workersIdle);
+		static uint64_t PeakRss();
+		static void ResetPeakRss();
+		void UpdatePeak(MemoryId id, uint64_t bytes);
+		bool stageStarted_;
+		bool progress_;
+		size_t workers_;
+		Stage current_;
+		uint64_t traceStart_;
+		std::clock_t cpuStart_;
+		std::chrono::steady_clock::time_point wallStart_;
+		std::vector<Stage> stage_;
+		std::vector<std::pair<std::string, std::string> > parameter_;
+		std::atomic<uint64_t> counter_[COUNTERS_COUNT];
+		std::atomic<int64_t> memory_[MEMORY_COUNT];
+		std::atomic<uint64_t> memoryPeak_[MEMORY_COUNT];
+	};
+}
+
+#endif
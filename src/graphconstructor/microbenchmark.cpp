@@ -0,0 +1,442 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iomanip>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#include <tclap/CmdLine.h>
+#include <spooky/SpookyV2.h>
+
+#include "test.h"
+#include "vertexenumerator.h"
+
+namespace
+{
+	//Hardware counters of the calling thread read with perf_event_open. A counter
+	//that can't be opened (no PMU access, a virtual machine, another OS) is skipped.
+	class PerfCounters
+	{
+	public:
+		static const size_t EVENTS_COUNT = 5;
+
+		PerfCounters()
+		{
+			std::fill(fd_, fd_ + EVENTS_COUNT, -1);
+#ifdef __linux__
+			const uint64_t l1dMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			const uint64_t dtlbMiss = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			const uint32_t type[] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE };
+			const uint64_t config[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, l1dMiss, dtlbMiss };
+			for (size_t i = 0; i < EVENTS_COUNT; i++)
+			{
+				perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = type[i];
+				attr.config = config[i];
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				fd_[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+			}
+#endif
+		}
+
+		~PerfCounters()
+		{
+			for (int fd : fd_)
+			{
+				if (fd != -1)
+				{
+					close(fd);
+				}
+			}
+		}
+
+		static const char * Name(size_t idx)
+		{
+			static const char * name[] = { "cycles", "instr", "llc-miss", "l1d-miss", "dtlb-miss" };
+			return name[idx];
+		}
+
+		void Start()
+		{
+#ifdef __linux__
+			for (int fd : fd_)
+			{
+				if (fd != -1)
+				{
+					ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+					ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+#endif
+		}
+
+		//Returns false for the counters that are not available
+		void Stop(uint64_t(&value)[EVENTS_COUNT], bool(&available)[EVENTS_COUNT])
+		{
+			for (size_t i = 0; i < EVENTS_COUNT; i++)
+			{
+				available[i] = false;
+#ifdef __linux__
+				if (fd_[i] != -1)
+				{
+					ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+					available[i] = read(fd_[i], &value[i], sizeof(value[i])) == sizeof(value[i]);
+				}
+#endif
+			}
+		}
+
+	private:
+		int fd_[EVENTS_COUNT];
+	};
+
+	//Keeps the results of the kernels alive
+	volatile uint64_t sink;
+
+	class Bench
+	{
+	public:
+		Bench(const std::string & filter) : filter_(filter)
+		{
+			std::cout << std::left << std::setw(28) << "kernel" << std::right << std::setw(12) << "ops" << std::setw(10) << "ns/op";
+			for (size_t i = 0; i < PerfCounters::EVENTS_COUNT; i++)
+			{
+				std::cout << std::setw(13) << (std::string(PerfCounters::Name(i)) + "/op");
+			}
+
+			std::cout << std::endl;
+		}
+
+		bool Enabled(const std::string & name) const
+		{
+			return name.find(filter_) != std::string::npos;
+		}
+
+		//Runs the kernel that does ops operations and prints the cost of one of them
+		template<class F>
+		void Measure(const std::string & name, uint64_t ops, F kernel)
+		{
+			if (!Enabled(name) || ops == 0)
+			{
+				return;
+			}
+
+			uint64_t value[PerfCounters::EVENTS_COUNT];
+			bool available[PerfCounters::EVENTS_COUNT];
+			counters_.Start();
+			auto start = std::chrono::steady_clock::now();
+			kernel();
+			double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			counters_.Stop(value, available);
+			std::cout << std::left << std::setw(28) << name << std::right << std::setw(12) << ops << std::setw(10) << std::fixed << std::setprecision(2) << elapsed / ops;
+			for (size_t i = 0; i < PerfCounters::EVENTS_COUNT; i++)
+			{
+				if (available[i])
+				{
+					std::cout << std::setw(13) << double(value[i]) / ops;
+				}
+				else
+				{
+					std::cout << std::setw(13) << "-";
+				}
+			}
+
+			std::cout << std::endl;
+		}
+
+	private:
+		std::string filter_;
+		PerfCounters counters_;
+	};
+
+	template<size_t CAPACITY>
+	void RunKernels(Bench & bench, const std::string & seq, size_t k, const std::string & tmpDir)
+	{
+		typedef TwoPaCo::CompressedString<CAPACITY> DnaString;
+		const size_t positions = seq.size() - k;
+		{
+			std::vector<std::string> edge;
+			for (size_t pos = 0; pos + k + 1 <= seq.size() && edge.size() < (1 << 18); pos++)
+			{
+				edge.push_back(seq.substr(pos, k + 1));
+			}
+
+			bench.Measure("canonical edge", edge.size(), [&]()
+			{
+				uint64_t ret = 0;
+				for (const std::string & now : edge)
+				{
+					ret += TwoPaCo::CanonicalEdgeValue(now);
+				}
+
+				sink = ret;
+			});
+		}
+
+		{
+			TwoPaCo::VertexRollingHashSeed seed(1, k, 64);
+			bench.Measure("rolling hash update", positions, [&]()
+			{
+				uint64_t ret = 0;
+				TwoPaCo::VertexRollingHash hash(seed, seq.begin(), 1);
+				for (size_t pos = 0; pos < positions; pos++)
+				{
+					hash.Update(seq[pos], seq[pos + k]);
+					ret += hash.RawPositiveHash(0);
+				}
+
+				sink = ret;
+			});
+		}
+
+		const size_t FILTER_CAPACITY = 1 << 20;
+		std::vector<uint64_t> key(FILTER_CAPACITY);
+		for (size_t i = 0; i < key.size(); i++)
+		{
+			key[i] = TwoPaCo::CanonicalEdgeValue(seq.substr(i % positions, k + 1)) ^ (uint64_t(i / positions) << 62);
+		}
+
+		for (size_t load : { 25, 50, 90 })
+		{
+			std::stringstream addName;
+			std::stringstream containName;
+			addName << "cuckoo add " << load << "%";
+			containName << "cuckoo contain " << load << "%";
+			if (!bench.Enabled(addName.str()) && !bench.Enabled(containName.str()))
+			{
+				continue;
+			}
+
+			size_t count = FILTER_CAPACITY * load / 100;
+			cuckoofilter::CuckooFilter<uint64_t, 32> filter(FILTER_CAPACITY);
+			bench.Measure(addName.str(), count, [&]()
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					filter.Add(key[i]);
+				}
+			});
+
+			//Half of the queries are present in the filter
+			bench.Measure(containName.str(), count, [&]()
+			{
+				uint64_t ret = 0;
+				for (size_t i = 0; i < count; i++)
+				{
+					ret += filter.Contain(i % 2 == 0 ? key[i] : ~key[i]) == cuckoofilter::Ok ? 1 : 0;
+				}
+
+				sink = ret;
+			});
+		}
+
+		std::vector<DnaString> str(std::min(positions, size_t(1) << 18));
+		bench.Measure("compressed copy", str.size(), [&]()
+		{
+			for (size_t i = 0; i < str.size(); i++)
+			{
+				str[i].CopyFromString(seq.begin() + i, k);
+			}
+		});
+
+		bench.Measure("compressed less", str.size() - 1, [&]()
+		{
+			uint64_t ret = 0;
+			for (size_t i = 0; i + 1 < str.size(); i++)
+			{
+				ret += DnaString::Less(str[i], str[i + 1]) ? 1 : 0;
+			}
+
+			sink = ret;
+		});
+
+		bench.Measure("compressed hash", str.size(), [&]()
+		{
+			uint64_t ret = 0;
+			for (const DnaString & now : str)
+			{
+				ret += now.Hash();
+			}
+
+			sink = ret;
+		});
+
+		//The reference the k-mer hash is compared with in the quality test
+		bench.Measure("spooky hash", str.size(), [&]()
+		{
+			uint64_t ret = 0;
+			for (const DnaString & now : str)
+			{
+				ret += SpookyHash::Hash64(&now, sizeof(now), 0);
+			}
+
+			sink = ret;
+		});
+
+		if (bench.Enabled("storage get id"))
+		{
+			//Every eighth vertex is a junction
+			const std::string storageFileName = tmpDir + "/microbench_storage.bin";
+			uint64_t vertices = 0;
+			{
+				std::ofstream out(storageFileName.c_str(), std::ios::binary);
+				for (size_t pos = 0; pos < positions; pos += 8, vertices++)
+				{
+					DnaString vertex;
+					vertex.CopyFromString(seq.begin() + pos, k);
+					vertex.WriteToFile(out);
+				}
+			}
+
+			TwoPaCo::BifurcationStorage<CAPACITY> storage;
+			{
+				std::ifstream in(storageFileName.c_str(), std::ios::binary);
+				storage.Init(in, vertices, k, 1);
+			}
+
+			std::remove(storageFileName.c_str());
+			bench.Measure("storage get id", positions, [&]()
+			{
+				uint64_t ret = 0;
+				for (size_t pos = 0; pos < positions; pos++)
+				{
+					ret += storage.GetId(seq.begin() + pos);
+				}
+
+				sink = ret;
+			});
+		}
+
+		if (bench.Enabled("fasta get char"))
+		{
+			const std::string fastaFileName = tmpDir + "/microbench.fa";
+			{
+				std::ofstream out(fastaFileName.c_str());
+				out << ">microbench" << std::endl;
+				for (size_t pos = 0; pos < seq.size(); pos += 60)
+				{
+					out << seq.substr(pos, 60) << std::endl;
+				}
+			}
+
+			bench.Measure("fasta get char", seq.size(), [&]()
+			{
+				char ch;
+				uint64_t ret = 0;
+				TwoPaCo::StreamFastaParser parser(fastaFileName);
+				while (parser.ReadRecord())
+				{
+					while (parser.GetChar(ch))
+					{
+						ret += ch;
+					}
+				}
+
+				sink = ret;
+			});
+
+			std::remove(fastaFileName.c_str());
+		}
+
+		if (bench.Enabled("junction writer"))
+		{
+			const std::string junctionsFileName = tmpDir + "/microbench_junctions.bin";
+			bench.Measure("junction writer", positions, [&]()
+			{
+				TwoPaCo::JunctionPositionWriter writer(junctionsFileName);
+				for (size_t pos = 0; pos < positions; pos++)
+				{
+					writer.WriteJunction(TwoPaCo::JunctionPosition(0, uint32_t(pos), int64_t(pos % 1000) - 500));
+				}
+			});
+
+			std::remove(junctionsFileName.c_str());
+		}
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	try
+	{
+		TCLAP::CmdLine cmd("Micro-benchmarks of the construction kernels", ' ', "0.9.2");
+
+		TCLAP::ValueArg<unsigned int> kvalue("k",
+			"kvalue",
+			"Value of k",
+			false,
+			31,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<uint64_t> length("",
+			"length",
+			"Length of the random sequence the kernels run on",
+			false,
+			1 << 22,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<std::string> kernel("",
+			"kernel",
+			"Run only the kernels with names containing this string",
+			false,
+			"",
+			"string",
+			cmd);
+
+		TCLAP::ValueArg<std::string> tmpDirName("",
+			"tmpdir",
+			"Temporary directory name",
+			false,
+			".",
+			"directory name",
+			cmd);
+
+		cmd.parse(argc, argv);
+		size_t k = kvalue.getValue();
+		if (k == 0 || k > 63 || length.getValue() <= k + 1)
+		{
+			throw std::runtime_error("k must be between 1 and 63 and shorter than the sequence");
+		}
+
+		std::string seq;
+		TwoPaCo::GenerateSequence(1, length.getValue(), seq, 0);
+		Bench bench(kernel.getValue());
+		if (k <= 32)
+		{
+			RunKernels<1>(bench, seq, k, tmpDirName.getValue());
+		}
+		else
+		{
+			RunKernels<2>(bench, seq, k, tmpDirName.getValue());
+		}
+	}
+	catch (TCLAP::ArgException & e)
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+		return 1;
+	}
+	catch (std::runtime_error & e)
+	{
+		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
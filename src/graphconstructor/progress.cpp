@@ -0,0 +1,229 @@
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <condition_variable>
+
+#include <sys/stat.h>
+#include <tbb/compat/thread>
+
+#include "progress.h"
+
+namespace TwoPaCo
+{
+	namespace
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		struct Reporter
+		{
+			std::mutex mutex;
+			std::condition_variable wake;
+			bool stop;
+			double interval;
+			std::string statusFileName;
+			std::string stage;
+			int64_t round;
+			bool exact;
+			uint64_t total;
+			uint64_t processed;
+			Clock::time_point stageStart;
+			Clock::time_point lastChange;
+			std::unique_ptr<tbb::tbb_thread> thread;
+
+			Reporter() : stop(false), interval(0), round(-1), exact(false), total(0), processed(0)
+			{
+
+			}
+
+			//Joins the thread if the construction was interrupted by an exception
+			~Reporter()
+			{
+				Progress::Disable();
+			}
+		};
+
+		Reporter & GetReporter()
+		{
+			static Reporter reporter;
+			return reporter;
+		}
+
+		//Input passes that follow the given stage in the same round
+		size_t PassesLeft(const std::string & stage)
+		{
+			if (stage == "filling")
+			{
+				return 2;
+			}
+
+			return stage == "candidates" ? 1 : 0;
+		}
+
+		std::string FormatTime(double seconds)
+		{
+			uint64_t total = uint64_t(seconds + 0.5);
+			std::stringstream ss;
+			ss << total / 3600 << ':' << std::setfill('0') << std::setw(2) << total / 60 % 60 << ':' << std::setw(2) << total % 60;
+			return ss.str();
+		}
+	}
+
+	std::atomic<bool> Progress::enabled_(false);
+	std::atomic<uint64_t> Progress::processed_(0);
+
+	void Progress::Enable(double interval, const std::string & statusFileName, const std::vector<std::string> & fileName)
+	{
+		Reporter & reporter = GetReporter();
+		Disable();
+		uint64_t total = 0;
+		for (const std::string & name : fileName)
+		{
+			struct stat st;
+			if (stat(name.c_str(), &st) == 0)
+			{
+				total += st.st_size;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(reporter.mutex);
+			reporter.stop = false;
+			reporter.interval = interval > 0 ? interval : 1;
+			reporter.statusFileName = statusFileName;
+			reporter.stage.clear();
+			reporter.round = -1;
+			reporter.exact = false;
+			reporter.total = total;
+			reporter.processed = 0;
+			reporter.stageStart = reporter.lastChange = Clock::now();
+		}
+
+		processed_ = 0;
+		enabled_ = true;
+		reporter.thread.reset(new tbb::tbb_thread(Run));
+	}
+
+	void Progress::Disable()
+	{
+		Reporter & reporter = GetReporter();
+		if (reporter.thread)
+		{
+			{
+				std::lock_guard<std::mutex> lock(reporter.mutex);
+				reporter.stop = true;
+			}
+
+			reporter.wake.notify_all();
+			reporter.thread->join();
+			reporter.thread.reset();
+		}
+
+		enabled_ = false;
+	}
+
+	void Progress::StartStage(const std::string & name, int64_t round)
+	{
+		if (Enabled())
+		{
+			Reporter & reporter = GetReporter();
+			std::lock_guard<std::mutex> lock(reporter.mutex);
+			reporter.stage = name;
+			reporter.round = round;
+			reporter.processed = 0;
+			reporter.stageStart = reporter.lastChange = Clock::now();
+			processed_ = 0;
+		}
+	}
+
+	void Progress::FinishInput(uint64_t bases)
+	{
+		if (Enabled())
+		{
+			Reporter & reporter = GetReporter();
+			std::lock_guard<std::mutex> lock(reporter.mutex);
+			reporter.exact = true;
+			reporter.total = bases;
+		}
+	}
+
+	void Progress::Report(bool last)
+	{
+		Reporter & reporter = GetReporter();
+		std::stringstream ss;
+		{
+			std::lock_guard<std::mutex> lock(reporter.mutex);
+			if (reporter.stage.empty())
+			{
+				return;
+			}
+
+			Clock::time_point now = Clock::now();
+			uint64_t processed = processed_;
+			if (processed != reporter.processed)
+			{
+				reporter.processed = processed;
+				reporter.lastChange = now;
+			}
+
+			double elapsed = std::chrono::duration<double>(now - reporter.stageStart).count();
+			ss << std::fixed << std::setprecision(1) << "Progress: ";
+			if (reporter.round >= 0)
+			{
+				ss << "round " << reporter.round << ", ";
+			}
+
+			ss << reporter.stage << ", " << FormatTime(elapsed) << " elapsed";
+			if (processed > 0 && reporter.total > 0)
+			{
+				//The estimate from the file sizes also counts headers and line breaks, while
+				//the workers count the overlaps of the tasks twice. The speed is measured
+				//until the last change, so it stays put when the workers are done.
+				uint64_t total = reporter.total;
+				uint64_t done = std::min(processed, total);
+				double speed = processed / std::max(std::chrono::duration<double>(reporter.lastChange - reporter.stageStart).count(), 1e-3);
+				double passLeft = (total - done) / speed;
+				ss << ", " << (reporter.exact ? "" : "~") << 100.0 * done / total << "% of " << total << " bases, "
+					<< speed / 1e6 << " Mbp/s, pass ETA " << FormatTime(passLeft);
+				if (reporter.round >= 0)
+				{
+					ss << ", round ETA " << FormatTime(passLeft + PassesLeft(reporter.stage) * total / speed);
+				}
+			}
+		}
+
+		if (!reporter.statusFileName.empty())
+		{
+			//Written to a temporary file first, so readers never see a half-written status
+			std::string tempFileName = reporter.statusFileName + ".tmp";
+			std::ofstream status(tempFileName.c_str());
+			status << ss.str() << (last ? ", finished" : "") << std::endl;
+			status.close();
+			std::rename(tempFileName.c_str(), reporter.statusFileName.c_str());
+		}
+		else if (!last)
+		{
+			std::cerr << ss.str() << std::endl;
+		}
+	}
+
+	void Progress::Run()
+	{
+		Reporter & reporter = GetReporter();
+		std::unique_lock<std::mutex> lock(reporter.mutex);
+		while (!reporter.stop)
+		{
+			auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(reporter.interval));
+			while (!reporter.stop && reporter.wake.wait_until(lock, deadline) != std::cv_status::timeout);
+			bool last = reporter.stop;
+			lock.unlock();
+			Report(last);
+			lock.lock();
+		}
+	}
+}
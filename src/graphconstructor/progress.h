@@ -0,0 +1,51 @@
+#ifndef _PROGRESS_H_
+#define _PROGRESS_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "common.h"
+
+namespace TwoPaCo
+{
+	//Periodically reports the share of the input processed by the current pass, the
+	//speed and the expected time to finish the pass and the round. A background
+	//thread prints the report to stderr or rewrites the status file. The workers
+	//add the length of every task they take, so the hot path only pays a relaxed
+	//atomic add per task. Nothing is reported until Enable is called.
+	class Progress
+	{
+	public:
+		//The size of the input files is used as an estimate of the number of bases
+		//until the first pass over the input is finished
+		static void Enable(double interval, const std::string & statusFileName, const std::vector<std::string> & fileName);
+		static void Disable();
+		static bool Enabled()
+		{
+			return enabled_.load(std::memory_order_relaxed);
+		}
+
+		static void StartStage(const std::string & name, int64_t round);
+		static void AddBases(uint64_t bases)
+		{
+			if (Enabled())
+			{
+				processed_.fetch_add(bases, std::memory_order_relaxed);
+			}
+		}
+
+		//Called by the producer when a pass over the input is over with the number of
+		//bases read, the total is exact since then
+		static void FinishInput(uint64_t bases);
+
+	private:
+		static void Report(bool last);
+		static void Run();
+		static std::atomic<bool> enabled_;
+		static std::atomic<uint64_t> processed_;
+	};
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+
+#include "sharedreader.h"
+
+namespace TwoPaCo
+{
+	SharedReader::SharedReader(const FastaInput & input, const std::vector<size_t> & overlapSize) :
+		input_(input),
+		overlapSize_(*std::max_element(overlapSize.begin(), overlapSize.end())),
+		minOverlapSize_(*std::min_element(overlapSize.begin(), overlapSize.end())),
+		pass_(overlapSize.size(), 0),
+		inPass_(overlapSize.size(), false),
+		finished_(new std::atomic<bool>[overlapSize.size()])
+	{
+		for (size_t i = 0; i < overlapSize.size(); i++)
+		{
+			finished_[i] = false;
+			feed_.push_back(std::unique_ptr<Feed>(new Feed()));
+			feed_.back()->set_capacity(FEED_CAPACITY);
+		}
+
+		thread_.reset(new tbb::tbb_thread(std::bind(&SharedReader::Run, this)));
+	}
+
+	SharedReader::~SharedReader()
+	{
+		for (size_t i = 0; i < feed_.size(); i++)
+		{
+			Finish(i);
+		}
+
+		thread_->join();
+	}
+
+	size_t SharedReader::GetOverlapSize() const
+	{
+		return overlapSize_;
+	}
+
+	bool SharedReader::Next(size_t consumer, Chunk & chunk)
+	{
+		if (!inPass_[consumer])
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			inPass_[consumer] = true;
+			pass_[consumer]++;
+			wake_.notify_all();
+		}
+
+		feed_[consumer]->pop(chunk);
+		{
+			//The reader may wait for the room in the feed
+			std::lock_guard<std::mutex> lock(mutex_);
+			wake_.notify_all();
+		}
+
+		if (!chunk.str && !chunk.sequence)
+		{
+			inPass_[consumer] = false;
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!error_.empty())
+			{
+				throw StreamFastaParser::Exception(error_);
+			}
+
+			return false;
+		}
+
+		return true;
+	}
+
+	void SharedReader::Finish(size_t consumer)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		finished_[consumer] = true;
+		wake_.notify_all();
+	}
+
+	void SharedReader::Broadcast(const Chunk & chunk)
+	{
+		//Sleeps until the consumer pops a chunk or finishes, Next and Finish notify
+		//under the lock, so a wakeup can't be lost between try_push and wait
+		for (size_t i = 0; i < feed_.size(); i++)
+		{
+			if (!feed_[i]->try_push(chunk))
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				while (!finished_[i] && !feed_[i]->try_push(chunk))
+				{
+					wake_.wait(lock);
+				}
+			}
+		}
+	}
+
+	void SharedReader::Run()
+	{
+		std::stringstream null;
+		for (size_t pass = 1;; pass++)
+		{
+			{
+				//Waits until a consumer starts the pass or all of them are done
+				std::unique_lock<std::mutex> lock(mutex_);
+				bool started = false;
+				bool finished = false;
+				for (;;)
+				{
+					finished = true;
+					for (size_t i = 0; i < feed_.size(); i++)
+					{
+						finished = finished && finished_[i];
+						started = started || (!finished_[i] && pass_[i] >= pass);
+					}
+
+					if (started || finished)
+					{
+						break;
+					}
+
+					wake_.wait(lock);
+				}
+
+				if (!started)
+				{
+					return;
+				}
+			}
+
+			try
+			{
+				SplitInput(input_, overlapSize_, minOverlapSize_, null,
+					[this](uint64_t record, uint64_t start, bool isFinal, std::string && str)
+					{
+						Chunk chunk;
+						chunk.record = record;
+						chunk.start = start;
+						chunk.isFinal = isFinal;
+						chunk.str = std::make_shared<const std::string>(std::move(str));
+						Broadcast(chunk);
+					},
+					[this](uint64_t record, SequenceRecord && sequence)
+					{
+						Chunk chunk;
+						chunk.record = record;
+						chunk.sequence = std::make_shared<const SequenceRecord>(std::move(sequence));
+						Broadcast(chunk);
+					});
+			}
+			catch (std::runtime_error & e)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				error_ = e.what();
+			}
+
+			Broadcast(Chunk());
+		}
+	}
+}
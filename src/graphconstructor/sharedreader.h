@@ -0,0 +1,139 @@
+#ifndef _SHARED_READER_H_
+#define _SHARED_READER_H_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <condition_variable>
+
+#include <tbb/compat/thread>
+#include <tbb/concurrent_queue.h>
+
+#include <junctionapi/sequencemanifest.h>
+
+#include "common.h"
+#include "tracer.h"
+#include "streamfastaparser.h"
+
+namespace TwoPaCo
+{
+	//Splits every sequence of the input into chunks of at most Task::TASK_SIZE
+	//characters overlapping by overlapSize characters. Undefined characters become N,
+	//a sequence is also padded by N from both sides. A chunk is passed to
+	//onChunk(record, start, isFinal, str) if it has at least minSize characters before
+	//the padding, onRecord(record, sequenceRecord) follows the last chunk of a sequence
+	template<class OnChunk, class OnRecord>
+	void SplitInput(const FastaInput & input, size_t overlapSize, size_t minSize, std::ostream & logFile, OnChunk onChunk, OnRecord onRecord)
+	{
+		//Only written with LOGGING
+		(void)logFile;
+		size_t record = 0;
+		for (size_t file = 0; file < input.Size(); file++)
+		{
+#ifdef LOGGING
+			logFile << "Reading " << input.GetName(file) << std::endl;
+#endif
+			std::unique_ptr<StreamFastaParser> parser = input.Open(file);
+			for (; parser->ReadRecord(); record++)
+			{
+				Tracer::Span span("read record");
+#ifdef LOGGING
+				logFile << "Processing sequence " << parser->GetCurrentHeader() << std::endl;
+#endif
+				char ch;
+				uint64_t prev = 0;
+				uint64_t start = 0;
+				std::string buf = "N";
+				bool over = false;
+				do
+				{
+					over = !parser->GetChar(ch);
+					if (!over)
+					{
+						start++;
+						buf.push_back(DnaChar::IsDefinite(ch) ? ch : 'N');
+					}
+
+					if (buf.size() >= minSize && (buf.size() == Task::TASK_SIZE || over))
+					{
+						std::string overlap;
+						if (!over)
+						{
+							overlap.assign(buf.end() - overlapSize, buf.end());
+						}
+						else
+						{
+							buf.push_back('N');
+						}
+
+						onChunk(record, prev, over, std::move(buf));
+						prev = start - overlapSize + 1;
+						buf.swap(overlap);
+					}
+
+				} while (!over);
+
+				onRecord(record, SequenceRecord(input.GetName(file), parser->GetCurrentHeader(), start, parser->GetCurrentOffset(), parser->GetLineWidth(), parser->GetLineBytes()));
+			}
+		}
+	}
+
+	//Splits the input once per pass and hands the chunks to several consumers, so a
+	//pass of all of them costs one parse of the input. The chunks overlap by the largest
+	//overlap of the consumers, each consumer cuts them down to its own. The consumers
+	//must make the same passes in the same order, a pass starts once any of them asks
+	//for it and the slowest one holds the rest back
+	class SharedReader
+	{
+	public:
+		struct Chunk
+		{
+			uint64_t record;
+			uint64_t start;
+			bool isFinal;
+			//A chunk of a sequence
+			std::shared_ptr<const std::string> str;
+			//The end of a sequence, both pointers are null at the end of the pass
+			std::shared_ptr<const SequenceRecord> sequence;
+
+			Chunk() : record(0), start(0), isFinal(false)
+			{
+
+			}
+		};
+
+		SharedReader(const FastaInput & input, const std::vector<size_t> & overlapSize);
+		~SharedReader();
+		size_t GetOverlapSize() const;
+		//Blocks until the next chunk of the current pass of the consumer is ready,
+		//returns false at the end of the pass and throws if the input is broken
+		bool Next(size_t consumer, Chunk & chunk);
+		//The consumer makes no more passes, must be called even if it failed
+		void Finish(size_t consumer);
+
+	private:
+		DISALLOW_COPY_AND_ASSIGN(SharedReader);
+		static const size_t FEED_CAPACITY = 16;
+		typedef tbb::concurrent_bounded_queue<Chunk> Feed;
+
+		void Run();
+		void Broadcast(const Chunk & chunk);
+
+		FastaInput input_;
+		size_t overlapSize_;
+		size_t minOverlapSize_;
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::string error_;
+		std::vector<size_t> pass_;
+		std::vector<char> inPass_;
+		std::unique_ptr<std::atomic<bool>[]> finished_;
+		std::vector<std::unique_ptr<Feed> > feed_;
+		std::unique_ptr<tbb::tbb_thread> thread_;
+	};
+}
+
+#endif
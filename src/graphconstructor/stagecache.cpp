@@ -0,0 +1,123 @@
+#include <cerrno>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <spooky/SpookyV2.h>
+
+#include "stagecache.h"
+#include "vertexrollinghash.h"
+
+namespace TwoPaCo
+{
+	namespace
+	{
+		//Changes whenever the format of an artifact does
+		const size_t CACHE_VERSION = 1;
+	}
+
+	StageCache::StageCache(const std::string & directory, const FastaInput & input, size_t vertexLength, size_t filterSize, size_t hashFunctions, size_t rounds)
+	{
+		if (directory.empty())
+		{
+			return;
+		}
+
+		std::stringstream description;
+		description << CACHE_VERSION << ' ' << VertexRollingHashSeed::VERSION << ' ' << vertexLength << ' ' << filterSize << ' ' << hashFunctions << ' ' << rounds;
+		for (size_t i = 0; i < input.Size(); i++)
+		{
+			const std::string & name = input.GetName(i);
+			struct stat st;
+			if (name.empty())
+			{
+				throw std::runtime_error("The stage cache can only be used with input files");
+			}
+
+			if (stat(name.c_str(), &st) != 0)
+			{
+				throw std::runtime_error("Can't open file " + name);
+			}
+
+			description << '\n' << name << '\t' << st.st_size << '\t' << st.st_mtim.tv_sec << '\t' << st.st_mtim.tv_nsec;
+		}
+
+		std::string str = description.str();
+		std::stringstream key;
+		key << std::hex << std::setw(16) << std::setfill('0') << SpookyHash::Hash64(str.data(), str.size(), 0);
+		key_ = key.str();
+		dirName_ = directory + "/" + key_;
+		if (mkdir(dirName_.c_str(), 0777) != 0 && errno != EEXIST)
+		{
+			throw std::runtime_error("Can't create the stage cache directory " + dirName_);
+		}
+	}
+
+	bool StageCache::Enabled() const
+	{
+		return !dirName_.empty();
+	}
+
+	std::string StageCache::GetKey() const
+	{
+		return key_;
+	}
+
+	std::string StageCache::GetDirName() const
+	{
+		return dirName_;
+	}
+
+	bool StageCache::Has(const std::string & artifact) const
+	{
+		return Enabled() && std::ifstream(GetFileName(artifact).c_str()).good();
+	}
+
+	std::string StageCache::GetFileName(const std::string & artifact) const
+	{
+		return dirName_ + "/" + artifact;
+	}
+
+	std::string StageCache::GetTempFileName(const std::string & artifact) const
+	{
+		return dirName_ + "/" + artifact + ".tmp";
+	}
+
+	void StageCache::Commit(const std::string & artifact) const
+	{
+		if (std::rename(GetTempFileName(artifact).c_str(), GetFileName(artifact).c_str()) != 0)
+		{
+			throw std::runtime_error("Can't write to the stage cache");
+		}
+	}
+
+	void StageCache::Clear() const
+	{
+		if (DIR * dir = opendir(dirName_.c_str()))
+		{
+			for (struct dirent * entry = readdir(dir); entry != 0; entry = readdir(dir))
+			{
+				std::string name = entry->d_name;
+				if (name != "." && name != "..")
+				{
+					std::remove(GetFileName(name).c_str());
+				}
+			}
+
+			closedir(dir);
+			rmdir(dirName_.c_str());
+		}
+	}
+
+	std::string StageCache::RoundArtifact(const std::string & name, size_t round)
+	{
+		std::stringstream ss;
+		ss << name << "." << round;
+		return ss.str();
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef _STAGE_CACHE_H_
+#define _STAGE_CACHE_H_
+
+#include <string>
+
+#include "common.h"
+#include "streamfastaparser.h"
+
+namespace TwoPaCo
+{
+	//Outputs of the finished stages kept in a subdirectory of the cache directory. It
+	//is named by a hash of the parameters and of the name, size and modification time
+	//of every input file, so a restarted or a repeated run finds the outputs regardless
+	//of the output file name. An artifact is written under a temporary name and renamed
+	//once complete, so a crashed run never leaves a partial one
+	class StageCache
+	{
+	public:
+		//The cache is disabled if the directory name is empty, otherwise the
+		//subdirectory of the key is created
+		StageCache(const std::string & directory, const FastaInput & input, size_t vertexLength, size_t filterSize, size_t hashFunctions, size_t rounds);
+		bool Enabled() const;
+		std::string GetKey() const;
+		std::string GetDirName() const;
+		bool Has(const std::string & artifact) const;
+		std::string GetFileName(const std::string & artifact) const;
+		//The artifact is written to this file and becomes visible after Commit
+		std::string GetTempFileName(const std::string & artifact) const;
+		void Commit(const std::string & artifact) const;
+		//Removes the artifacts and the subdirectory of the key
+		void Clear() const;
+		//The name of an artifact produced by every round
+		static std::string RoundArtifact(const std::string & name, size_t round);
+
+	private:
+		DISALLOW_COPY_AND_ASSIGN(StageCache);
+		std::string key_;
+		std::string dirName_;
+	};
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <set>
 #include <map>
+#include <cmath>
+#include <cstdlib>
 #include <random>
 #include <cassert>
 #include <sstream>
@@ -7,7 +9,12 @@
 #include <stdexcept>
 #include <algorithm>
 
+#include <unistd.h>
+
+#include <spooky/SpookyV2.h>
+
 #include "test.h"
+#include "twopaco.h"
 #include "vertexenumerator.h"
 
 namespace TwoPaCo
@@ -17,15 +24,16 @@ namespace TwoPaCo
 		return ch == 'A' || ch == 'C' || ch == 'G' || ch == 'T';
 	}
 
-	void GenerateSequence(std::random_device & rd, size_t length, std::string & out)
+	void GenerateSequence(uint32_t seed, size_t length, std::string & out, double nRate)
 	{
 		out.resize(length);
-		std::mt19937 e2(rd());
+		std::mt19937 e2(seed);
 		std::string alphabet("ACGT");
 		std::uniform_int_distribution<> gen(0, alphabet.size() - 1);
+		std::uniform_real_distribution<> nGen(0, 1);
 		for (size_t i = 0; i < out.size(); i++)
 		{
-			if (rand() % 500 == 0)
+			if (nGen(e2) < nRate)
 			{
 				out[i] = 'N';
 			}
@@ -36,26 +44,27 @@ namespace TwoPaCo
 		}
 	}
 
-	void MutateSequence(std::random_device & rd, const std::string & chr, double changeRate, double mutationRate, std::string & out)
+	void MutateSequence(uint32_t seed, const std::string & chr, double changeRate, double mutationRate, std::string & out)
 	{
 		out.clear();
-		std::mt19937 e2(rd());
+		std::mt19937 e2(seed);
 		std::string alphabet("ACGT");
 		std::uniform_real_distribution<> gen(0, 1);
+		std::uniform_int_distribution<> charGen(0, alphabet.size() - 1);
 		for (auto ch : chr)
 		{
 			if (gen(e2) <= changeRate)
 			{
 				if (gen(e2) <= mutationRate)
 				{
-					out.push_back(alphabet[rand() % alphabet.size()]);
+					out.push_back(alphabet[charGen(e2)]);
 				}
 				else
 				{
 					if (gen(e2) <= 0.5)
 					{
 						out.push_back(ch);
-						out.push_back(alphabet[rand() % alphabet.size()]);
+						out.push_back(alphabet[charGen(e2)]);
 					}
 				}
 			}
@@ -68,6 +77,451 @@ namespace TwoPaCo
 
 	namespace
 	{
+		const size_t LINE_WIDTH = 60;
+
+		bool CheckManifest(const std::vector<std::string> & chr, const std::string & manifestFileName)
+		{
+			SequenceManifest manifest;
+			if (!manifest.ReadFromFile(manifestFileName) || manifest.Size() != chr.size())
+			{
+				return false;
+			}
+
+			std::string buf;
+			for (size_t i = 0; i < chr.size(); i++)
+			{
+				if (manifest[i].length != chr[i].size() || manifest[i].lineWidth != LINE_WIDTH)
+				{
+					return false;
+				}
+
+				size_t start = rand() % chr[i].size();
+				size_t length = rand() % (LINE_WIDTH * 3);
+				manifest.ReadSequence(i, start, length, buf);
+				if (buf != chr[i].substr(start, length))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		bool CheckDnaKernels(const std::string & chr)
+		{
+			const size_t MAX_WINDOW = 4 * 32;
+			for (size_t it = 0; it < 100; it++)
+			{
+				size_t size = rand() % std::min(MAX_WINDOW, chr.size());
+				std::string window = chr.substr(rand() % (chr.size() - size), size);
+				uint64_t nMask[MAX_WINDOW / 64] = { 0 };
+				DnaChar::NMask(window.data(), size, nMask);
+				size_t definite = 0;
+				for (size_t i = 0; i < size; i++)
+				{
+					definite += IsDefinite(window[i]) ? 1 : 0;
+					if (((nMask[i / 64] >> (i % 64)) & 1) != (IsDefinite(window[i]) ? 0 : 1))
+					{
+						return false;
+					}
+				}
+
+				if (DnaChar::CountDefinite(window.data(), size) != definite)
+				{
+					return false;
+				}
+
+				std::replace(window.begin(), window.end(), 'N', 'A');
+				std::string reverse = DnaChar::ReverseCompliment(window);
+				uint64_t packed[MAX_WINDOW / 32] = { 0 };
+				uint64_t packedReverse[MAX_WINDOW / 32] = { 0 };
+				uint64_t expected[MAX_WINDOW / 32] = { 0 };
+				uint64_t expectedReverse[MAX_WINDOW / 32] = { 0 };
+				DnaChar::Pack(window.data(), size, packed);
+				DnaChar::ReverseComplementPacked(packed, size, packedReverse);
+				for (size_t i = 0; i < size; i++)
+				{
+					expected[i / 32] |= uint64_t(DnaChar::MakeUpChar(window[i])) << (i % 32 * 2);
+					expectedReverse[i / 32] |= uint64_t(DnaChar::MakeUpChar(reverse[i])) << (i % 32 * 2);
+				}
+
+				if (!std::equal(packed, packed + MAX_WINDOW / 32, expected) || !std::equal(packedReverse, packedReverse + MAX_WINDOW / 32, expectedReverse))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		//The rolled hash must match the one computed from scratch and the hash of
+		//the reverse strand must be the hash of the reverse complement
+		bool CheckRollingHash(const std::string & chr, size_t k)
+		{
+			VertexRollingHashSeed seed(1, k, 64);
+			VertexRollingHash hash(seed, chr.begin(), 1);
+			for (size_t pos = 0; pos + k <= chr.size(); pos++)
+			{
+				std::string reverse = DnaChar::ReverseCompliment(chr.substr(pos, k));
+				if (hash.RawPositiveHash(0) != seed.PositiveBase(chr.begin() + pos, k) ||
+					hash.RawNegativeHash(0) != seed.PositiveBase(reverse.begin(), k))
+				{
+					return false;
+				}
+
+				if (pos + k < chr.size())
+				{
+					hash.Update(chr[pos], chr[pos + k]);
+				}
+			}
+
+			//The derived functions must be pairwise distinct, 64 bit values of two
+			//independent functions practically never coincide
+			const size_t FUNCTIONS = 8;
+			VertexRollingHashSeed derived(FUNCTIONS, k, 64);
+			for (size_t pos = 0; pos + k <= chr.size(); pos++)
+			{
+				uint64_t value[FUNCTIONS];
+				uint64_t base = derived.PositiveBase(chr.begin() + pos, k);
+				derived.DeriveAll(base, k, value, FUNCTIONS);
+				for (size_t i = 0; i < FUNCTIONS; i++)
+				{
+					if (value[i] != derived.Derive(base, k, i))
+					{
+						return false;
+					}
+
+					for (size_t j = 0; j < i; j++)
+					{
+						if (value[i] == value[j])
+						{
+							return false;
+						}
+					}
+				}
+			}
+
+			return true;
+		}
+
+		void WriteFasta(std::vector<std::string>::const_iterator begin, std::vector<std::string>::const_iterator end, const std::string & fileName)
+		{
+			std::ofstream test(fileName.c_str());
+			if (!test)
+			{
+				throw std::runtime_error("Can't create a temporary file for testing");
+			}
+
+			for (size_t j = 0; begin != end; ++begin, ++j)
+			{
+				test << ">" << j << std::endl;
+				for (size_t pos = 0; pos < begin->size(); pos += LINE_WIDTH)
+				{
+					test << begin->substr(pos, LINE_WIDTH) << std::endl;
+				}
+			}
+		}
+
+		//Builds the graph of the first half of the sequences, extends it with the rest
+		//and compares the result with the graph of all sequences built from scratch.
+		//Junction ids must be the same, stubs are only required to be at the same places
+		bool CheckExtension(const std::vector<std::string> & chr, size_t k, size_t filterBits, size_t hashFunctions, size_t threads, const std::string & temporaryDir)
+		{
+			const size_t split = chr.size() / 2;
+			const std::string firstFasta = temporaryDir + "/first.fa";
+			const std::string secondFasta = temporaryDir + "/second.fa";
+			const std::string allFasta = temporaryDir + "/all.fa";
+			const std::string baseEdge = temporaryDir + "/base.bin";
+			const std::string extendedEdge = temporaryDir + "/extended.bin";
+			const std::string fullEdge = temporaryDir + "/full.bin";
+			WriteFasta(chr.begin(), chr.begin() + split, firstFasta);
+			WriteFasta(chr.begin() + split, chr.end(), secondFasta);
+			WriteFasta(chr.begin(), chr.end(), allFasta);
+
+			std::stringstream null;
+			size_t junctions = CreateEnumerator(std::vector<std::string>(1, allFasta), k, filterBits, hashFunctions, 1, threads, temporaryDir, fullEdge, null)->GetVerticesCount();
+			CreateEnumerator(std::vector<std::string>(1, firstFasta), k, filterBits, hashFunctions, 1, threads, temporaryDir, baseEdge, null, std::string(), true);
+			size_t extendedJunctions = CreateEnumerator(std::vector<std::string>(1, secondFasta), k, filterBits, hashFunctions, 1, threads, temporaryDir, extendedEdge, null, baseEdge)->GetVerticesCount();
+
+			bool ret = junctions == extendedJunctions && CheckManifest(chr, SequenceManifest::DefaultFileName(extendedEdge));
+			{
+				JunctionPosition fullPos;
+				JunctionPosition extendedPos;
+				JunctionPositionReader fullReader(fullEdge);
+				JunctionPositionReader extendedReader(extendedEdge);
+				while (ret && fullReader.NextJunctionPosition(fullPos))
+				{
+					ret = extendedReader.NextJunctionPosition(extendedPos) && fullPos.GetChr() == extendedPos.GetChr() && fullPos.GetPos() == extendedPos.GetPos();
+					if (ret && (size_t(std::abs(fullPos.GetId())) <= junctions || size_t(std::abs(extendedPos.GetId())) <= junctions))
+					{
+						ret = fullPos.GetId() == extendedPos.GetId();
+					}
+				}
+
+				ret = ret && !extendedReader.NextJunctionPosition(extendedPos);
+			}
+
+			const std::string edge[] = { baseEdge, extendedEdge, fullEdge };
+			for (const std::string & fileName : edge)
+			{
+				std::remove(fileName.c_str());
+				std::remove(SequenceManifest::DefaultFileName(fileName).c_str());
+				std::remove((fileName + ".state").c_str());
+				std::remove((fileName + ".filter").c_str());
+				std::remove((fileName + ".junctions").c_str());
+			}
+
+			std::remove(firstFasta.c_str());
+			std::remove(secondFasta.c_str());
+			std::remove(allFasta.c_str());
+			return ret;
+		}
+
+		//Builds the graph of the sequences in memory without writing the output and
+		//collects the junctions from the callback, they must come in order
+		bool CheckCallback(const std::vector<std::string> & chr, size_t k, size_t filterBits, size_t hashFunctions, size_t threads, const std::string & temporaryDir, const std::vector<std::vector<bool> > & naiveMarks)
+		{
+			Options options;
+			options.vertexLength = k;
+			options.filterSize = filterBits;
+			options.hashFunctions = hashFunctions;
+			options.threads = threads;
+			options.tmpDirName = temporaryDir;
+			std::vector<std::vector<bool> > mark(chr.size());
+			for (size_t i = 0; i < chr.size(); i++)
+			{
+				mark[i].assign(chr[i].size(), false);
+			}
+
+			bool ordered = true;
+			JunctionPosition prev;
+			std::stringstream null;
+			BuildGraph(FastaInput(chr, std::vector<std::string>()), options, [&](const JunctionPosition & pos)
+			{
+				ordered = ordered && (prev.GetChr() == UINT32_MAX || prev.GetChr() < pos.GetChr() || (prev.GetChr() == pos.GetChr() && prev.GetPos() < pos.GetPos()));
+				mark[pos.GetChr()][pos.GetPos()] = true;
+				prev = pos;
+			}, null);
+
+			return ordered && mark == naiveMarks;
+		}
+
+		//Builds the graph twice with the stage cache in the temporary directory, the
+		//second run must take everything but the edges from the cache. The third run
+		//has only the filters cached and must not measure them with an empty edge sample
+		bool CheckCache(const std::vector<std::string> & fileName, size_t k, size_t filterBits, size_t hashFunctions, size_t rounds, const std::string & temporaryDir, const std::vector<std::vector<bool> > & naiveMarks)
+		{
+			const std::string edge = temporaryDir + "/cached.bin";
+			bool ret = true;
+			for (size_t run = 0; run < 3 && ret; run++)
+			{
+				if (run == 2)
+				{
+					StageCache cache(temporaryDir, fileName, k, filterBits, hashFunctions, rounds);
+					for (size_t round = 0; round < rounds; round++)
+					{
+						std::remove(cache.GetFileName(StageCache::RoundArtifact("junctions", round)).c_str());
+					}
+				}
+
+				std::stringstream null;
+				std::unique_ptr<VertexEnumerator> vid = CreateEnumerator(fileName, k, filterBits, hashFunctions, rounds, 1, temporaryDir, edge, null, std::string(), false, JunctionCallback(), temporaryDir);
+				std::vector<std::vector<bool> > mark(naiveMarks.size());
+				for (size_t i = 0; i < mark.size(); i++)
+				{
+					mark[i].assign(naiveMarks[i].size(), false);
+				}
+
+				JunctionPositionReader(edge).RestoreAllVectors(mark);
+				ret = mark == naiveMarks && (run == 0 || (vid->GetMetrics().Get(Metrics::FILTER_INSERTS) == 0 && vid->GetMetrics().Get(Metrics::SAMPLED_PROBES) == 0));
+			}
+
+			StageCache(temporaryDir, fileName, k, filterBits, hashFunctions, rounds).Clear();
+			std::remove(edge.c_str());
+			std::remove(SequenceManifest::DefaultFileName(edge).c_str());
+			return ret;
+		}
+
+		//Builds the graph of two files with the membership file, the records of a file
+		//form one genome and the row of every junction must list the genomes where the
+		//junctions file has it
+		bool CheckMembership(const std::vector<std::string> & chr, size_t k, size_t filterBits, size_t hashFunctions, size_t threads, const std::string & temporaryDir)
+		{
+			const size_t split = (chr.size() + 1) / 2;
+			const std::string edge = temporaryDir + "/membership.bin";
+			std::vector<std::string> fileName(1, temporaryDir + "/membership0.fa");
+			WriteFasta(chr.begin(), chr.begin() + split, fileName.back());
+			if (split < chr.size())
+			{
+				fileName.push_back(temporaryDir + "/membership1.fa");
+				WriteFasta(chr.begin() + split, chr.end(), fileName.back());
+			}
+
+			std::stringstream null;
+			size_t junctions = CreateEnumerator(fileName, k, filterBits, hashFunctions, 1, threads, temporaryDir, edge, null, std::string(), false, JunctionCallback(), std::string(), true)->GetVerticesCount();
+			std::vector<std::vector<bool> > expected(junctions, std::vector<bool>(fileName.size(), false));
+			{
+				JunctionPosition pos;
+				JunctionPositionReader reader(edge);
+				while (reader.NextJunctionPosition(pos))
+				{
+					if (size_t(std::abs(pos.GetId())) <= junctions)
+					{
+						expected[std::abs(pos.GetId()) - 1][pos.GetChr() < split ? 0 : 1] = true;
+					}
+				}
+			}
+
+			bool ret = true;
+			{
+				std::vector<bool> member;
+				JunctionMembershipReader reader(JunctionMembershipReader::DefaultFileName(edge));
+				ret = reader.GetJunctionsCount() == junctions && reader.GetGenomesCount() == fileName.size();
+				for (size_t i = 0; i < junctions && ret; i++)
+				{
+					reader.ReadRow(i + 1, member);
+					ret = member == expected[i] && reader.Contains(-int64_t(i + 1), i % fileName.size()) == expected[i][i % fileName.size()];
+				}
+			}
+
+			for (const std::string & name : fileName)
+			{
+				std::remove(name.c_str());
+			}
+
+			std::remove(edge.c_str());
+			std::remove(SequenceManifest::DefaultFileName(edge).c_str());
+			std::remove(JunctionMembershipReader::DefaultFileName(edge).c_str());
+			return ret;
+		}
+
+		bool CheckBitVector(const std::string & temporaryDir)
+		{
+			const size_t SIZE = (size_t(1) << 20) + 17;
+			const std::string fileName = temporaryDir + "/bits.bin";
+			std::vector<bool> naive(SIZE, false);
+			ConcurrentBitVector bits(SIZE);
+			ConcurrentBitVector other(SIZE);
+			for (size_t i = 0; i < SIZE / 16; i++)
+			{
+				size_t idx = rand() % SIZE;
+				naive[idx] = true;
+				(i % 2 == 0 ? bits : other).SetBitConcurrently(idx);
+			}
+
+			bits.MergeOr(other);
+			bits.WriteToFile(fileName);
+			bool ret = true;
+			{
+				ConcurrentBitVector mapped(SIZE, fileName);
+				for (size_t i = 0; i < SIZE && ret; i++)
+				{
+					ret = mapped.GetBit(i) == naive[i] && bits.GetBit(i) == naive[i];
+				}
+			}
+
+			bits.Reset();
+			bits.ReadFromFile(fileName, true);
+			for (size_t i = 0; i < SIZE && ret; i++)
+			{
+				ret = bits.GetBit(i) == naive[i];
+			}
+
+			other.Reset();
+			for (size_t i = 0; i < SIZE && ret; i++)
+			{
+				ret = !other.GetBit(i);
+			}
+
+			return ret;
+		}
+
+		//Chi-square statistic of the distribution of the keys over the buckets
+		//selected by the lowest and the highest bits of the hash
+		template<class Key, class F>
+		double BucketChiSquare(const std::vector<Key> & key, F hash, bool high)
+		{
+			const size_t BUCKETS_POWER = 12;
+			std::vector<size_t> bucket(size_t(1) << BUCKETS_POWER, 0);
+			for (const Key & now : key)
+			{
+				uint64_t value = hash(now);
+				++bucket[high ? value >> (64 - BUCKETS_POWER) : value & (bucket.size() - 1)];
+			}
+
+			double ret = 0;
+			double expected = double(key.size()) / bucket.size();
+			for (size_t count : bucket)
+			{
+				ret += (count - expected) * (count - expected) / expected;
+			}
+
+			return ret;
+		}
+
+		//Compares the k-mer hash and the rolling hash with SpookyHash on the occurences of
+		//consecutive k-mers of a random sequence, which is what the hash table of
+		//candidates and the filters are filled with
+		template<size_t VERTEX_LENGTH>
+		bool CheckHashQuality(std::random_device & rd)
+		{
+			const size_t KEYS = 1 << 16;
+			typedef CompressedString<CalculateNeededCapacity(VERTEX_LENGTH)> Key;
+			std::string chr;
+			GenerateSequence(rd(), KEYS + VERTEX_LENGTH, chr);
+			std::replace(chr.begin(), chr.end(), 'N', 'A');
+			std::vector<Key > key(KEYS);
+			std::vector<size_t> start(KEYS);
+			for (size_t i = 0; i < KEYS; i++)
+			{
+				key[i].CopyFromString(chr.begin() + i, VERTEX_LENGTH);
+				start[i] = i;
+			}
+
+			VertexRollingHashSeed seed(2, VERTEX_LENGTH, 64);
+			auto fastHash = [](const Key & str) { return str.Hash(); };
+			auto spookyHash = [](const Key & str) { return SpookyHash::Hash64(&str, sizeof(str), 0); };
+			auto rollingHash = [&](size_t pos) { return seed.Derive(seed.PositiveBase(chr.begin() + pos, VERTEX_LENGTH), VERTEX_LENGTH, 1); };
+			double limit = 0;
+			for (bool high : { false, true })
+			{
+				//The statistic has 4095 degrees of freedom, allow eight standard deviations
+				limit = std::max(limit, BucketChiSquare(key, spookyHash, high));
+				double fast = BucketChiSquare(key, fastHash, high);
+				double rolling = BucketChiSquare(start, rollingHash, high);
+				if (fast > std::max(limit, 4095 + 8 * sqrt(2 * 4095.0)) || rolling > std::max(limit, 4095 + 8 * sqrt(2 * 4095.0)))
+				{
+					return false;
+				}
+			}
+
+			//Flipping a bit of the key should flip about half of the bits of the hash.
+			//The same goes for the rolling hash when two characters of the k-mer are
+			//swapped, including the ones at a distance of a multiple of 64
+			size_t flipped = 0;
+			size_t rollingFlipped = 0;
+			size_t trials = 0;
+			for (size_t i = 0; i < 1024; i++)
+			{
+				Key other = key[i];
+				size_t pos = rand() % VERTEX_LENGTH;
+				other.SetChar(pos, DnaChar::ReverseChar(key[i].GetChar(pos)));
+				flipped += __builtin_popcountll(other.Hash() ^ key[i].Hash());
+				std::string original = chr.substr(i, VERTEX_LENGTH);
+				size_t distance = VERTEX_LENGTH > 64 ? 64 : 1 + rand() % (VERTEX_LENGTH - 1);
+				size_t first = rand() % (VERTEX_LENGTH - distance);
+				original[first] = original[first + distance] == 'A' ? 'C' : 'A';
+				std::string swapped = original;
+				std::swap(swapped[first], swapped[first + distance]);
+				rollingFlipped += __builtin_popcountll(seed.PositiveBase(swapped.begin(), VERTEX_LENGTH) ^ seed.PositiveBase(original.begin(), VERTEX_LENGTH));
+				trials++;
+			}
+
+			double average = double(flipped) / trials;
+			double rollingAverage = double(rollingFlipped) / trials;
+			return average > 30 && average < 34 && rollingAverage > 28 && rollingAverage < 36;
+		}
+
 		void FindJunctionsNaively(const std::vector<std::string> & chr, size_t vertexLength, std::set<std::string> & junction, std::vector<std::vector<bool> > & marks)
 		{
 			int unknownCount = CHAR_MAX;
@@ -158,6 +612,56 @@ namespace TwoPaCo
 				}
 			}
 		}
+
+		//Builds the graphs for all values of k in one pass over the input, each of them
+		//must have the junctions found naively for its k
+		bool CheckMultiK(const std::vector<std::string> & fileName, const std::vector<std::string> & chr, Range vertexSize, size_t filterBits, size_t hashFunctions, size_t threads, const std::string & temporaryDir)
+		{
+			const std::string edge = temporaryDir + "/multik.bin";
+			Options options;
+			options.filterSize = filterBits;
+			options.hashFunctions = hashFunctions;
+			options.rounds = 2;
+			options.threads = threads;
+			options.tmpDirName = temporaryDir;
+			options.outFileName = edge;
+			std::vector<size_t> vertexLength;
+			std::vector<std::stringstream> log;
+			std::vector<std::ostream*> logStream;
+			for (size_t k = vertexSize.first; k < vertexSize.second; k += 2)
+			{
+				vertexLength.push_back(k);
+			}
+
+			log.resize(vertexLength.size());
+			for (std::stringstream & ss : log)
+			{
+				logStream.push_back(&ss);
+			}
+
+			BuildGraphs(fileName, vertexLength, options, logStream);
+			bool ret = true;
+			for (size_t k : vertexLength)
+			{
+				std::set<std::string> junctions;
+				std::vector<std::vector<bool> > naiveMarks(chr.size());
+				std::vector<std::vector<bool> > mark(chr.size());
+				for (size_t i = 0; i < chr.size(); i++)
+				{
+					naiveMarks[i].assign(chr[i].size(), false);
+					mark[i].assign(chr[i].size(), false);
+				}
+
+				FindJunctionsNaively(chr, k, junctions, naiveMarks);
+				JunctionPositionReader(KFileName(edge, k)).RestoreAllVectors(mark);
+				ret = ret && mark == naiveMarks;
+				std::remove(KFileName(edge, k).c_str());
+				std::remove(SequenceManifest::DefaultFileName(KFileName(edge, k)).c_str());
+				rmdir((temporaryDir + "/k" + std::to_string(k)).c_str());
+			}
+
+			return ret;
+		}
 	}
 
 	bool RunTests(size_t tests, size_t filterBits, size_t length, size_t chrNumber, Range vertexSize, Range hashFunctions, Range rounds, Range threads, double changeRate, double indelRate, const std::string & temporaryDir)
@@ -167,29 +671,54 @@ namespace TwoPaCo
 		std::vector<std::string> fileName;
 		fileName.push_back(temporaryFasta);
 		std::random_device rd;		
+		if (!CheckHashQuality<31>(rd) || !CheckHashQuality<101>(rd))
+		{
+			std::cerr << "Hash quality test FAILED" << std::endl;
+			return false;
+		}
+
+		if (!CheckBitVector(temporaryDir))
+		{
+			std::cerr << "Bit vector test FAILED" << std::endl;
+			return false;
+		}
+
 		for (size_t t = 0; t < tests; t++)
 		{
 			std::vector<std::string> chr(chrNumber);
-			GenerateSequence(rd, length, chr[0]);
+			GenerateSequence(rd(), length, chr[0]);
 			for (size_t i = 1; i < chrNumber; i++)
 			{
-				MutateSequence(rd, chr[0], changeRate, indelRate, chr[i]);
+				MutateSequence(rd(), chr[0], changeRate, indelRate, chr[i]);
 			}
 
-			std::ofstream test(temporaryFasta.c_str());
-			if (!test)
+			WriteFasta(chr.begin(), chr.end(), temporaryFasta);
+			if (!CheckDnaKernels(chr[0]))
 			{
-				throw std::runtime_error("Can't create a temporary file for testing");
+				std::cerr << "Test # " << t << " FAILED, DNA kernels are wrong" << std::endl;
+				return false;
 			}
 
-			for (size_t j = 0; j < chrNumber; ++j)
+			if (!CheckRollingHash(chr[0], vertexSize.first))
 			{
-				test << ">" << j << std::endl;
-				test << chr[j] << std::endl;
+				std::cerr << "Test # " << t << " FAILED, the rolling hash is wrong" << std::endl;
+				return false;
 			}
-			
+
+			if (!CheckMultiK(fileName, chr, vertexSize, filterBits, hashFunctions.first, threads.first, temporaryDir))
+			{
+				std::cerr << "Test # " << t << " FAILED, the graphs built for several values of k at once are wrong" << std::endl;
+				return false;
+			}
+
 			for (size_t k = vertexSize.first; k < vertexSize.second; k += 2)
 			{
+				if (chrNumber > 1 && !CheckExtension(chr, k, filterBits, hashFunctions.first, threads.first, temporaryDir))
+				{
+					std::cerr << "Test # " << t << " FAILED, the extended graph differs from the one built from scratch" << std::endl;
+					return false;
+				}
+
 				std::set<std::string> junctions;				
 				std::vector<std::vector<bool > > naiveMarks(chrNumber);				
 				for (size_t i = 0; i < chrNumber; i++)
@@ -199,6 +728,24 @@ namespace TwoPaCo
 
 				std::vector<std::vector<bool > > fastMarks(chrNumber);
 				FindJunctionsNaively(chr, k, junctions, naiveMarks);
+				if (!CheckCallback(chr, k, filterBits, hashFunctions.first, threads.first, temporaryDir, naiveMarks))
+				{
+					std::cerr << "Test # " << t << " FAILED, the junctions passed to the callback are wrong" << std::endl;
+					return false;
+				}
+
+				if (!CheckCache(fileName, k, filterBits, hashFunctions.first, 2, temporaryDir, naiveMarks))
+				{
+					std::cerr << "Test # " << t << " FAILED, the run with the stage cache is wrong" << std::endl;
+					return false;
+				}
+
+				if (!CheckMembership(chr, k, filterBits, hashFunctions.first, threads.first, temporaryDir))
+				{
+					std::cerr << "Test # " << t << " FAILED, the membership file is wrong" << std::endl;
+					return false;
+				}
+
 				for (size_t hf = hashFunctions.first; hf < hashFunctions.second; ++hf)
 				{
 					for (size_t r = rounds.first; r < rounds.second; ++r)
@@ -212,6 +759,12 @@ namespace TwoPaCo
 								fastMarks[i].assign(chr[i].size(), false);
 							}
 
+							if (!CheckManifest(chr, SequenceManifest::DefaultFileName(temporaryEdge)))
+							{
+								std::cerr << "Test # " << t << " FAILED, the sequence manifest is wrong" << std::endl;
+								return false;
+							}
+
 							JunctionPositionReader reader(temporaryEdge);
 							reader.RestoreAllVectors(fastMarks);
 							if (naiveMarks != fastMarks)
@@ -247,6 +800,7 @@ namespace TwoPaCo
 
 			std::remove(temporaryFasta.c_str());
 			std::remove(temporaryEdge.c_str());
+			std::remove(SequenceManifest::DefaultFileName(temporaryEdge).c_str());
 			std::cerr << "Test # " << t << " PASSED" << std::endl;
 		}
 
@@ -3,11 +3,17 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <iostream>
 
 namespace TwoPaCo
 {
 	typedef std::pair<size_t, size_t> Range;	
+	//Random sequence with N characters placed with the given probability, the same seed gives the same sequence
+	void GenerateSequence(uint32_t seed, size_t length, std::string & out, double nRate = 0.002);
+	//Copy of the sequence with a fraction changeRate of positions changed, a change is a
+	//substitution with the probability mutationRate and an insertion or a deletion otherwise
+	void MutateSequence(uint32_t seed, const std::string & chr, double changeRate, double mutationRate, std::string & out);
 	bool RunTests(size_t tests, size_t filterBits, size_t length, size_t chrNumber, Range vertexSize, Range hashFunctions, Range rounds, Range threads, double changeRate, double indelRate, const std::string & temporaryDir);
 }
 
@@ -0,0 +1,110 @@
+#include <set>
+#include <vector>
+#include <memory>
+
+#include <tbb/mutex.h>
+
+#include "tracer.h"
+
+namespace TwoPaCo
+{
+	namespace
+	{
+		struct Event
+		{
+			const char * name;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		struct ThreadBuffer
+		{
+			size_t tid;
+			uint64_t recorded;
+			std::vector<Event> event;
+		};
+
+		struct Registry
+		{
+			tbb::mutex mutex;
+			uint64_t start;
+			size_t eventsPerThread;
+			std::set<std::string> name;
+			std::vector<std::unique_ptr<ThreadBuffer> > buffer;
+		};
+
+		Registry & GetRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		//Buffers are owned by the registry since threads exit before the trace is written
+		thread_local ThreadBuffer * localBuffer = 0;
+	}
+
+	std::atomic<bool> Tracer::enabled_(false);
+
+	void Tracer::Enable(size_t eventsPerThread)
+	{
+		Registry & registry = GetRegistry();
+		registry.mutex.lock();
+		registry.start = Now();
+		registry.eventsPerThread = max(eventsPerThread, size_t(1));
+		registry.mutex.unlock();
+		enabled_ = true;
+	}
+
+	void Tracer::Record(const char * name, uint64_t begin, uint64_t end)
+	{
+		if (localBuffer == 0)
+		{
+			Registry & registry = GetRegistry();
+			registry.mutex.lock();
+			registry.buffer.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+			localBuffer = registry.buffer.back().get();
+			localBuffer->tid = registry.buffer.size();
+			localBuffer->recorded = 0;
+			localBuffer->event.resize(registry.eventsPerThread);
+			registry.mutex.unlock();
+		}
+
+		Event & now = localBuffer->event[localBuffer->recorded++ % localBuffer->event.size()];
+		now.name = name;
+		now.begin = begin;
+		now.end = end;
+	}
+
+	void Tracer::Record(const std::string & name, uint64_t begin, uint64_t end)
+	{
+		Registry & registry = GetRegistry();
+		registry.mutex.lock();
+		const char * stored = registry.name.insert(name).first->c_str();
+		registry.mutex.unlock();
+		Record(stored, begin, end);
+	}
+
+	void Tracer::WriteJson(std::ostream & out)
+	{
+		Registry & registry = GetRegistry();
+		registry.mutex.lock();
+		bool first = true;
+		out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+		for (const std::unique_ptr<ThreadBuffer> & buffer : registry.buffer)
+		{
+			size_t size = buffer->event.size();
+			uint64_t count = std::min(buffer->recorded, uint64_t(size));
+			for (uint64_t i = buffer->recorded - count; i < buffer->recorded; i++)
+			{
+				const Event & now = buffer->event[i % size];
+				uint64_t begin = now.begin > registry.start ? now.begin - registry.start : 0;
+				out << (first ? "" : ",") << std::endl << "{\"name\": \"" << now.name << "\", \"cat\": \"twopaco\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+					<< buffer->tid << ", \"ts\": " << begin << ", \"dur\": " << now.end - now.begin << "}";
+				first = false;
+			}
+		}
+
+		out << std::endl << "]}" << std::endl;
+		registry.mutex.unlock();
+	}
+}
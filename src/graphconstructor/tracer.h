@@ -0,0 +1,69 @@
+#ifndef _TRACER_H_
+#define _TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+#include "common.h"
+
+namespace TwoPaCo
+{
+	//Records spans of work done by each thread and writes them in the Chrome trace
+	//event format, which can be opened in Perfetto or chrome://tracing. Every thread
+	//writes into its own ring buffer, so only the latest spans of a thread are kept.
+	//Nothing is recorded until Enable is called.
+	class Tracer
+	{
+	public:
+		static const size_t DEFAULT_EVENTS = 1 << 16;
+
+		//Covers the lifetime of the object, the name must be a string literal
+		class Span
+		{
+		public:
+			Span(const char * name) : name_(Enabled() ? name : 0), begin_(name_ != 0 ? Now() : 0)
+			{
+
+			}
+
+			~Span()
+			{
+				if (name_ != 0)
+				{
+					Record(name_, begin_, Now());
+				}
+			}
+
+		private:
+			DISALLOW_COPY_AND_ASSIGN(Span);
+			const char * name_;
+			uint64_t begin_;
+		};
+
+		static void Enable(size_t eventsPerThread = DEFAULT_EVENTS);
+		static bool Enabled()
+		{
+			return enabled_.load(std::memory_order_relaxed);
+		}
+
+		//Microseconds of the steady clock
+		static uint64_t Now()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		//For rare spans with computed names, the name is copied
+		static void Record(const std::string & name, uint64_t begin, uint64_t end);
+		//Must not be called while other threads are recording
+		static void WriteJson(std::ostream & out);
+
+	private:
+		static void Record(const char * name, uint64_t begin, uint64_t end);
+		static std::atomic<bool> enabled_;
+	};
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include "twopaco.h"
+
+namespace TwoPaCo
+{
+	namespace
+	{
+		void CheckOptions(const std::vector<size_t> & vertexLength, const Options & options)
+		{
+			for (size_t k : vertexLength)
+			{
+				if (k % 2 == 0)
+				{
+					throw std::runtime_error("The value of K must be odd");
+				}
+			}
+
+			if (options.filterSize == 0)
+			{
+				throw std::runtime_error("The filter size must be set");
+			}
+		}
+	}
+
+	std::string KFileName(const std::string & fileName, size_t vertexLength)
+	{
+		std::stringstream ss;
+		ss << fileName << ".k" << vertexLength;
+		return ss.str();
+	}
+
+	std::unique_ptr<VertexEnumerator> BuildGraph(const FastaInput & input, const Options & options, const JunctionCallback & callback, std::ostream & logStream)
+	{
+		CheckOptions(std::vector<size_t>(1, options.vertexLength), options);
+
+		return CreateEnumerator(input,
+			options.vertexLength,
+			options.filterSize,
+			options.hashFunctions,
+			options.rounds,
+			options.threads,
+			options.tmpDirName,
+			options.outFileName,
+			logStream,
+			options.extendFileName,
+			options.extendable,
+			callback,
+			options.cacheDirName,
+			options.membership);
+	}
+
+	std::vector<std::unique_ptr<VertexEnumerator> > BuildGraphs(const FastaInput & input, const std::vector<size_t> & vertexLength, const Options & options, const std::vector<std::ostream*> & logStream)
+	{
+		CheckOptions(vertexLength, options);
+		std::vector<size_t> sorted(vertexLength);
+		std::sort(sorted.begin(), sorted.end());
+		if (sorted.empty() || std::unique(sorted.begin(), sorted.end()) != sorted.end())
+		{
+			throw std::runtime_error("The values of K must be different");
+		}
+
+		if (!options.extendFileName.empty() || options.extendable || !options.cacheDirName.empty())
+		{
+			throw std::runtime_error("Several values of K can't be used with extension or the stage cache");
+		}
+
+		std::vector<std::string> tmpDirName;
+		std::vector<std::string> outFileName;
+		for (size_t k : vertexLength)
+		{
+			std::stringstream ss;
+			ss << options.tmpDirName << "/k" << k;
+			tmpDirName.push_back(ss.str());
+			if (mkdir(tmpDirName.back().c_str(), 0777) != 0 && errno != EEXIST)
+			{
+				throw std::runtime_error("Can't create the temporary directory " + tmpDirName.back());
+			}
+
+			outFileName.push_back(options.outFileName.empty() ? std::string() : KFileName(options.outFileName, k));
+		}
+
+		return CreateEnumerators(input,
+			vertexLength,
+			options.filterSize,
+			options.hashFunctions,
+			options.rounds,
+			options.threads,
+			tmpDirName,
+			outFileName,
+			logStream,
+			options.membership);
+	}
+}
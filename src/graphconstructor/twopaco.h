@@ -0,0 +1,54 @@
+#ifndef _TWOPACO_H_
+#define _TWOPACO_H_
+
+#include <string>
+#include <memory>
+#include <ostream>
+
+#include "vertexenumerator.h"
+
+namespace TwoPaCo
+{
+	//Parameters of the construction, the defaults are the ones of the twopaco tool
+	struct Options
+	{
+		//Must be odd
+		size_t vertexLength;
+		//Log2 of the number of bits in the filter, must be set
+		size_t filterSize;
+		size_t hashFunctions;
+		size_t rounds;
+		size_t threads;
+		std::string tmpDirName;
+		//The junctions file and its manifest are not written if the name is empty
+		std::string outFileName;
+		//Same as --extend and --extendable, both require the output file
+		std::string extendFileName;
+		bool extendable;
+		//Same as --cache, the artifacts of the stages are not kept if it is empty
+		std::string cacheDirName;
+		//Same as --membership, requires the output file
+		bool membership;
+
+		Options() : vertexLength(25), filterSize(0), hashFunctions(5), rounds(1), threads(1), tmpDirName("."), extendable(false), membership(false)
+		{
+
+		}
+	};
+
+	//Builds the condensed de Bruijn graph of the input. The junctions are passed to
+	//the callback in the order of the genomes while the edges are constructed, one
+	//call at a time from the worker threads. The returned enumerator gives the ids of
+	//the junction vertices
+	std::unique_ptr<VertexEnumerator> BuildGraph(const FastaInput & input, const Options & options, const JunctionCallback & callback, std::ostream & logStream);
+	//Builds the graphs for several values of k parsing the input once per pass, the
+	//vertex length of the options is ignored. The graph of every k writes its own log,
+	//its output goes to KFileName of the output file and its temporary files to the
+	//subdirectory k<k> of the temporary directory. Extension and the stage cache are
+	//not supported
+	std::vector<std::unique_ptr<VertexEnumerator> > BuildGraphs(const FastaInput & input, const std::vector<size_t> & vertexLength, const Options & options, const std::vector<std::ostream*> & logStream);
+	//The name with the suffix .k<vertexLength>
+	std::string KFileName(const std::string & fileName, size_t vertexLength);
+}
+
+#endif
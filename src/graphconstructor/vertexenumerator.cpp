@@ -15,7 +15,7 @@ namespace TwoPaCo
 	namespace
 	{
 		template<size_t CAPACITY>
-		std::unique_ptr<VertexEnumerator> CreateEnumeratorImpl(const std::vector<std::string> & fileName,
+		std::unique_ptr<VertexEnumerator> CreateEnumeratorImpl(const FastaInput & input,
 			size_t vertexLength,
 			size_t filterSize,
 			size_t hashFunctions,
@@ -23,12 +23,39 @@ namespace TwoPaCo
 			size_t threads,
 			const std::string & tmpFileName,
 			const std::string & outFileName,
-			std::ostream & logStream)
+			std::ostream & logStream,
+			const std::string & extendFileName,
+			bool saveState,
+			const JunctionCallback & callback,
+			const std::string & cacheDirName,
+			bool membership,
+			SharedReader * reader,
+			size_t consumer)
 		{
 			size_t neededCapacity = CalculateNeededCapacity(vertexLength);
 			if (CAPACITY == neededCapacity)
 			{
-				return std::unique_ptr<VertexEnumerator>(new VertexEnumeratorImpl<CAPACITY>(fileName,
+				if (OccurenceFlagsFitKey(vertexLength))
+				{
+					return std::unique_ptr<VertexEnumerator>(new VertexEnumeratorImpl<CAPACITY, true>(input,
+						vertexLength,
+						filterSize,
+						hashFunctions,
+						rounds,
+						threads,
+						tmpFileName,
+						outFileName,
+						logStream,
+						extendFileName,
+						saveState,
+						callback,
+						cacheDirName,
+						membership,
+						reader,
+						consumer));
+				}
+
+				return std::unique_ptr<VertexEnumerator>(new VertexEnumeratorImpl<CAPACITY, false>(input,
 					vertexLength,
 					filterSize,
 					hashFunctions,
@@ -36,10 +63,17 @@ namespace TwoPaCo
 					threads,
 					tmpFileName,
 					outFileName,
-					logStream));
+					logStream,
+					extendFileName,
+					saveState,
+					callback,
+					cacheDirName,
+					membership,
+					reader,
+					consumer));
 			}
 			
-			return CreateEnumeratorImpl<CAPACITY + 1>(fileName,
+			return CreateEnumeratorImpl<CAPACITY + 1>(input,
 				vertexLength,
 				filterSize,
 				hashFunctions,
@@ -47,11 +81,18 @@ namespace TwoPaCo
 				threads,
 				tmpFileName,
 				outFileName,
-				logStream);
+				logStream,
+				extendFileName,
+				saveState,
+				callback,
+				cacheDirName,
+				membership,
+				reader,
+				consumer);
 		}
 
 		template<>
-		std::unique_ptr<VertexEnumerator> CreateEnumeratorImpl<MAX_CAPACITY>(const std::vector<std::string> & fileName,
+		std::unique_ptr<VertexEnumerator> CreateEnumeratorImpl<MAX_CAPACITY>(const FastaInput & input,
 			size_t vertexLength,
 			size_t filterSize,
 			size_t hashFunctions,
@@ -59,14 +100,21 @@ namespace TwoPaCo
 			size_t threads,
 			const std::string & tmpFileName,
 			const std::string & outFileName,
-			std::ostream & logStream)
+			std::ostream & logStream,
+			const std::string & extendFileName,
+			bool saveState,
+			const JunctionCallback & callback,
+			const std::string & cacheDirName,
+			bool membership,
+			SharedReader * reader,
+			size_t consumer)
 		{
 			throw std::runtime_error("The value of K is too big. Please refer to documentaion how to increase the max supported value of K.");
 			return 0;
 		}		
 	}
 
-	std::unique_ptr<VertexEnumerator> CreateEnumerator(const std::vector<std::string> & fileName,
+	std::unique_ptr<VertexEnumerator> CreateEnumerator(const FastaInput & input,
 		size_t vertexLength,
 		size_t filterSize,
 		size_t hashFunctions,
@@ -74,9 +122,14 @@ namespace TwoPaCo
 		size_t threads,
 		const std::string & tmpFileName,
 		const std::string & outFileName,
-		std::ostream & logStream)
+		std::ostream & logStream,
+		const std::string & extendFileName,
+		bool saveState,
+		const JunctionCallback & callback,
+		const std::string & cacheDirName,
+		bool membership)
 	{
-		return CreateEnumeratorImpl<1>(fileName,
+		return CreateEnumeratorImpl<1>(input,
 			vertexLength,
 			filterSize,
 			hashFunctions,
@@ -84,6 +137,82 @@ namespace TwoPaCo
 			threads,
 			tmpFileName,
 			outFileName,
-			logStream);
+			logStream,
+			extendFileName,
+			saveState,
+			callback,
+			cacheDirName,
+			membership,
+			0,
+			0);
+	}
+
+	std::vector<std::unique_ptr<VertexEnumerator> > CreateEnumerators(const FastaInput & input,
+		const std::vector<size_t> & vertexLength,
+		size_t filterSize,
+		size_t hashFunctions,
+		size_t rounds,
+		size_t threads,
+		const std::vector<std::string> & tmpDirName,
+		const std::vector<std::string> & outFileName,
+		const std::vector<std::ostream*> & logStream,
+		bool membership)
+	{
+		std::vector<size_t> overlapSize;
+		for (size_t k : vertexLength)
+		{
+			overlapSize.push_back(k + 1);
+		}
+
+		SharedReader reader(input, overlapSize);
+		std::vector<std::unique_ptr<VertexEnumerator> > ret(vertexLength.size());
+		std::vector<std::string> error(vertexLength.size());
+		std::vector<std::unique_ptr<tbb::tbb_thread> > engineThread(vertexLength.size());
+		for (size_t i = 0; i < vertexLength.size(); i++)
+		{
+			engineThread[i].reset(new tbb::tbb_thread([&, i]()
+			{
+				try
+				{
+					ret[i] = CreateEnumeratorImpl<1>(input,
+						vertexLength[i],
+						filterSize,
+						hashFunctions,
+						rounds,
+						threads,
+						tmpDirName[i],
+						outFileName[i],
+						*logStream[i],
+						std::string(),
+						false,
+						JunctionCallback(),
+						std::string(),
+						membership,
+						&reader,
+						i);
+				}
+				catch (std::runtime_error & e)
+				{
+					error[i] = e.what();
+				}
+
+				reader.Finish(i);
+			}));
+		}
+
+		for (size_t i = 0; i < engineThread.size(); i++)
+		{
+			engineThread[i]->join();
+		}
+
+		for (size_t i = 0; i < error.size(); i++)
+		{
+			if (!error[i].empty())
+			{
+				throw std::runtime_error(error[i]);
+			}
+		}
+
+		return ret;
 	}
 }
\ No newline at end of file
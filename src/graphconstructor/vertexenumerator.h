@@ -4,6 +4,7 @@
 #define MAX_CAPACITY 20
 
 #include <deque>
+#include <cassert>
 #include <chrono>
 #include <ctime>
 #include <cstdio>
@@ -23,9 +24,17 @@
 #include <tbb/concurrent_unordered_set.h>
 
 #include <junctionapi/junctionapi.h>
+#include <junctionapi/sequencemanifest.h>
 
 #include <cuckoofilter/cuckoofilter.h>
 
+#include "tracer.h"
+#include "metrics.h"
+#include "progress.h"
+#include "stagecache.h"
+#include "sharedreader.h"
+#include "edgesample.h"
+#include "membershiptable.h"
 #include "vertexrollinghash.h"
 #include "streamfastaparser.h"
 #include "bifurcationstorage.h"
@@ -35,6 +44,9 @@ using namespace cuckoofilter;
 
 namespace TwoPaCo
 {
+	using std::ios;
+	using std::string;
+
 	class VertexEnumerator
 	{
 	public:
@@ -42,6 +54,7 @@ namespace TwoPaCo
 		virtual int64_t GetId(const std::string & vertex) const = 0;
 		virtual const VertexRollingHashSeed & GetHashSeed() const = 0;
 		virtual std::unique_ptr<ConcurrentBitVector> ReloadBloomFilter() const = 0;
+		virtual const Metrics & GetMetrics() const = 0;
 
 		virtual ~VertexEnumerator()
 		{
@@ -49,7 +62,7 @@ namespace TwoPaCo
 		}
 	};
 
-	std::unique_ptr<VertexEnumerator> CreateEnumerator(const std::vector<std::string> & fileName,
+	std::unique_ptr<VertexEnumerator> CreateEnumerator(const FastaInput & input,
 		size_t vertexLength,
 		size_t filterSize,
 		size_t hashFunctions,
@@ -57,9 +70,29 @@ namespace TwoPaCo
 		size_t threads,
 		const std::string & tmpFileName,
 		const std::string & outFileName,
-		std::ostream & logStream);
+		std::ostream & logStream,
+		const std::string & extendFileName = std::string(),
+		bool saveState = false,
+		const JunctionCallback & callback = JunctionCallback(),
+		const std::string & cacheDirName = std::string(),
+		bool membership = false);
+
+	//Builds the graphs of the same input for several values of k. Every engine runs
+	//with its own threads, temporary directory, output file and log, while the input
+	//is parsed once per pass and shared by all of them
+	std::vector<std::unique_ptr<VertexEnumerator> > CreateEnumerators(const FastaInput & input,
+		const std::vector<size_t> & vertexLength,
+		size_t filterSize,
+		size_t hashFunctions,
+		size_t rounds,
+		size_t threads,
+		const std::vector<std::string> & tmpDirName,
+		const std::vector<std::string> & outFileName,
+		const std::vector<std::ostream*> & logStream,
+		bool membership = false);
 
-	template<size_t CAPACITY>
+	//PACKED tells whether the flags of the candidate occurences fit into the unused bits of the key
+	template<size_t CAPACITY, bool PACKED>
 	class VertexEnumeratorImpl : public VertexEnumerator
 	{
 	private:
@@ -68,7 +101,7 @@ namespace TwoPaCo
 		static const size_t BUF_SIZE = 1 << 24;
 		BifurcationStorage<CAPACITY> bifStorage_;
 		typedef CompressedString<CAPACITY> DnaString;
-		typedef CandidateOccurence<CAPACITY> Occurence;
+		typedef CandidateOccurence<CAPACITY, PACKED> Occurence;
 
 		class FilterFillerWorker;
 
@@ -103,7 +136,7 @@ namespace TwoPaCo
 
 	public:
 
-		~VertexEnumeratorImpl<CAPACITY>()
+		~VertexEnumeratorImpl()
 		{
 			std::remove(filterDumpFile_.c_str());
 		}
@@ -123,15 +156,18 @@ namespace TwoPaCo
 			return hashFunctionSeed_;
 		}
 
+		const Metrics & GetMetrics() const
+		{
+			return metrics_;
+		}
+
 		std::unique_ptr<ConcurrentBitVector> ReloadBloomFilter() const
 		{
 			uint64_t realSize = uint64_t(1) << hashFunctionSeed_.BitsNumber();
-			std::unique_ptr<ConcurrentBitVector> ret(new ConcurrentBitVector(realSize));
-			ret->ReadFromFile(filterDumpFile_, false);
-			return ret;
+			return std::unique_ptr<ConcurrentBitVector>(new ConcurrentBitVector(realSize, filterDumpFile_));
 		}
 
-		VertexEnumeratorImpl(const std::vector<std::string> & fileName,
+		VertexEnumeratorImpl(const FastaInput & input,
 			size_t vertexLength,
 			size_t filterSize,
 			size_t hashFunctions,
@@ -139,7 +175,14 @@ namespace TwoPaCo
 			size_t threads,
 			const std::string & tmpDirName,
 			const std::string & outFileNamePrefix,
-			std::ostream & logStream) :
+			std::ostream & logStream,
+			const std::string & extendFileName,
+			bool saveState,
+			const JunctionCallback & callback,
+			const std::string & cacheDirName,
+			bool membership,
+			SharedReader * reader,
+			size_t consumer) :
 			vertexSize_(vertexLength),
 			hashFunctionSeed_(hashFunctions, vertexLength, filterSize),
 			filterDumpFile_(tmpDirName + "/filter.bin")
@@ -151,10 +194,22 @@ namespace TwoPaCo
 			logStream << "Filter size = " << realSize << std::endl;
 			logStream << "Capacity = " << CAPACITY << std::endl;
 			logStream << "Files: " << std::endl;
-			for (const std::string & fn : fileName)
+			std::vector<std::string> fileName;
+			for (size_t i = 0; i < input.Size(); i++)
 			{
-				logStream << fn << std::endl;
+				fileName.push_back(input.GetName(i));
+				logStream << (fileName.back().empty() ? "(sequences in memory)" : fileName.back()) << std::endl;
 			}
+
+			metrics_.SetParameter("k", vertexLength);
+			metrics_.SetParameter("filter_size", filterSize);
+			metrics_.SetParameter("hash_functions", hashFunctions);
+			metrics_.SetParameter("rounds", rounds);
+			metrics_.SetParameter("threads", threads);
+			metrics_.SetWorkers(threads);
+			metrics_.SetProgress(consumer == 0);
+			metrics_.SetParameter("capacity", CAPACITY);
+			metrics_.SetParameter("files", fileName);
 #ifdef LOGGING
 			std::ofstream logFile((tmpDirName + "/log.txt").c_str());
 			if (!logFile)
@@ -164,6 +219,63 @@ namespace TwoPaCo
 #else
 			std::ostream & logFile = std::cerr;
 #endif
+			//The manifest is collected during the first pass over the input
+			SequenceManifest manifest;
+			//When a graph is extended, the records of the new genomes follow the existing ones
+			size_t firstRecord = 0;
+			SequenceManifest oldManifest;
+			ExtensionState oldState;
+			std::vector<Revisit> revisit;
+			std::unique_ptr<BifurcationStorage<CAPACITY> > oldStorage;
+			if ((saveState || !extendFileName.empty()) && outFileNamePrefix.empty())
+			{
+				throw std::runtime_error("An extendable graph must be written to a file");
+			}
+
+			if (membership && outFileNamePrefix.empty())
+			{
+				throw std::runtime_error("The membership file is written next to the output file, which must be set");
+			}
+
+			if (!extendFileName.empty())
+			{
+				if (extendFileName == outFileNamePrefix)
+				{
+					throw std::runtime_error("The extended graph must be written to a new file");
+				}
+
+				if (rounds != 1)
+				{
+					throw std::runtime_error("A graph can only be extended in one round");
+				}
+
+				oldStorage = LoadState(extendFileName, vertexLength, filterSize, hashFunctions, threads, oldState, oldManifest);
+				firstRecord = oldManifest.Size();
+				metrics_.SetParameter("extend", extendFileName);
+				logStream << "Extending " << extendFileName << " with " << oldState.junctions << " junctions" << std::endl;
+			}
+
+			if (reader != 0 && (oldStorage || !cacheDirName.empty()))
+			{
+				throw std::runtime_error("Several graphs can't be extended or cached at once");
+			}
+
+			StageCache cache(cacheDirName, input, vertexLength, filterSize, hashFunctions, rounds);
+			if (cache.Enabled())
+			{
+				if (oldStorage)
+				{
+					throw std::runtime_error("The stage cache can't be used when extending a graph");
+				}
+
+				metrics_.SetParameter("cache_key", cache.GetKey());
+				logStream << "Stage cache key = " << cache.GetKey() << std::endl;
+			}
+
+			//The candidate sets of the rounds are kept in the cache as well
+			const std::string candidateDirName = cache.Enabled() ? cache.GetDirName() : tmpDirName;
+			//The manifest is committed to the cache before the other artifacts
+			bool cachedManifest = cache.Has(MANIFEST_ARTIFACT) && manifest.ReadFromFile(cache.GetFileName(MANIFEST_ARTIFACT));
 
 			tbb::mutex errorMutex;
 			std::unique_ptr<std::runtime_error> error;
@@ -179,28 +291,55 @@ namespace TwoPaCo
 			const uint64_t BIN_SIZE = max(uint64_t(1), realSize / BINS_COUNT);
 			std::atomic<uint32_t> * binCounter = 0;
 
-			if (rounds > 1)
+			if (rounds > 1 && cache.Has(BINS_ARTIFACT))
+			{
+				logStream << "Loading the split of the input kmers set from the cache..." << std::endl;
+				metrics_.StartStage("split");
+				binCounter = new std::atomic<uint32_t>[BINS_COUNT];
+				ReadBins(cache.GetFileName(BINS_ARTIFACT), binCounter);
+				metrics_.FinishStage();
+			}
+			else if (rounds > 1)
 			{
 				logStream << "Splitting the input kmers set..." << std::endl;
+				metrics_.StartStage("split");
 				std::vector<std::unique_ptr<tbb::tbb_thread> > workerThread(threads);
 				binCounter = new std::atomic<uint32_t>[BINS_COUNT];
 				std::fill(binCounter, binCounter + BINS_COUNT, 0);
 				CuckooFilter<uint64_t, 32> cuckooFilter(realSize + 1);
+				metrics_.SetMemory(Metrics::EDGE_FILTER, cuckooFilter.SizeInBytes());
 				for (size_t i = 0; i < workerThread.size(); i++)
 				{
 					InitialFilterFillerWorker worker(BIN_SIZE,
 						cuckooFilter,
 						vertexLength,
 						*taskQueue[i],
-						binCounter);
+						binCounter,
+						metrics_);
 					workerThread[i].reset(new tbb::tbb_thread(worker));
 				}
 
-				DistributeTasks(fileName, edgeLength, taskQueue, error, errorMutex, logFile);
+				DistributeTasks(input, edgeLength, taskQueue, error, errorMutex, metrics_, logFile, cachedManifest ? 0 : &manifest, firstRecord, reader, consumer);
 				for (size_t i = 0; i < workerThread.size(); i++)
 				{
 					workerThread[i]->join();
 				}
+
+				if (cache.Enabled())
+				{
+					if (!cachedManifest)
+					{
+						manifest.WriteToFile(cache.GetTempFileName(MANIFEST_ARTIFACT));
+						cache.Commit(MANIFEST_ARTIFACT);
+						cachedManifest = true;
+					}
+
+					WriteBins(cache.GetTempFileName(BINS_ARTIFACT), binCounter);
+					cache.Commit(BINS_ARTIFACT);
+				}
+
+				metrics_.FinishStage();
+				metrics_.SetMemory(Metrics::EDGE_FILTER, 0);
 			}
 
 			double roundSize = 0;
@@ -222,14 +361,8 @@ namespace TwoPaCo
 				throw StreamFastaParser::Exception("Can't create a temp file");
 			}
 
-			time_t mark;
-			size_t ioTime = 0;
 			for (size_t round = 0; round < rounds; round++)
 			{
-				std::atomic<uint64_t> marks;
-				marks = 0;
-				mark = time(0);
-
 				if (rounds > 1)
 				{
 					uint64_t accumulated = binCounter[lowBoundary];
@@ -252,47 +385,111 @@ namespace TwoPaCo
 					high = realSize;
 				}
 
+				const std::string junctionsArtifact = StageCache::RoundArtifact(JUNCTIONS_ARTIFACT, round);
+				if (cache.Has(junctionsArtifact))
 				{
+					metrics_.StartStage("junctions", round);
+					uint64_t falsePositives = 0;
+					uint64_t truePositives = ReadJunctions(cache.GetFileName(junctionsArtifact), bifurcationTempWrite, falsePositives);
+					metrics_.Add(Metrics::TRUE_JUNCTIONS, truePositives);
+					metrics_.Add(Metrics::FALSE_JUNCTIONS, falsePositives);
+					logStream << "Round " << round << ", " << low << ":" << high << std::endl;
+					logStream << "Junctions loaded from the cache: " << metrics_.FinishStage() << std::endl;
+					logStream << "True junctions count = " << truePositives << std::endl;
+					logStream << "False junctions count = " << falsePositives << std::endl;
+					logStream << std::string(80, '-') << std::endl;
+					totalFpCount += falsePositives;
+					verticesCount += truePositives;
+					low = high + 1;
+					continue;
+				}
+
+				metrics_.StartStage("filling", round);
+				uint64_t sampledEdges = 0;
+				bool filterSampled = false;
+				{
+					const std::string filterArtifact = StageCache::RoundArtifact(FILTER_ARTIFACT, round);
+					bool cachedFilter = cache.Has(filterArtifact);
 					CuckooFilter<uint64_t, 32> cFilter(realSize);
+					EdgeSample sample;
+					if (oldStorage)
+					{
+						cFilter.readFromFile(FilterFileName(extendFileName), false);
+					}
+
+					if (cachedFilter)
+					{
+						cFilter.readFromFile(cache.GetFileName(filterArtifact), false);
+					}
+
+					metrics_.SetMemory(Metrics::EDGE_FILTER, cFilter.SizeInBytes());
 					logStream << "Round " << round << ", " << low << ":" << high << std::endl;
 					logStream << "Pass\tFilling\tFiltering" << std::endl << "1\t";
+					//The sample only measures the filter if it holds all the edges of the filter
+					filterSampled = !cachedFilter && !oldStorage;
+					if (!cachedFilter)
 					{
 						std::vector<std::unique_ptr<tbb::tbb_thread> > workerThread(threads);
 						for (size_t i = 0; i < workerThread.size(); i++)
 						{
 							FilterFillerWorker worker(edgeLength,
 								std::ref(cFilter),
-								std::ref(*taskQueue[i]));
+								std::ref(sample),
+								std::ref(*taskQueue[i]),
+								metrics_);
 							workerThread[i].reset(new tbb::tbb_thread(worker));
 						}
 
-						DistributeTasks(fileName, edgeLength, taskQueue, error, errorMutex, logFile);
+						DistributeTasks(input, edgeLength, taskQueue, error, errorMutex, metrics_, logFile, rounds == 1 && round == 0 && !cachedManifest ? &manifest : 0, firstRecord, reader, consumer);
 						for (size_t i = 0; i < workerThread.size(); i++)
 						{
 							workerThread[i]->join();
 						}
+
+						if (cache.Enabled())
+						{
+							if (!cachedManifest)
+							{
+								manifest.WriteToFile(cache.GetTempFileName(MANIFEST_ARTIFACT));
+								cache.Commit(MANIFEST_ARTIFACT);
+								cachedManifest = true;
+							}
+
+							cFilter.writeToFile(cache.GetTempFileName(filterArtifact));
+							cache.Commit(filterArtifact);
+						}
 					}
 
-					logStream << time(0) - mark << "\t";
-					mark = time(0);
+					if (filterSampled)
+					{
+						sampledEdges = sample.Size();
+						metrics_.Add(Metrics::SAMPLED_EDGES, sampledEdges);
+					}
+					if ((saveState || oldStorage) && round == 0)
+					{
+						cFilter.writeToFile(FilterFileName(outFileNamePrefix));
+					}
+
+					logStream << metrics_.FinishStage() << "\t";
+					metrics_.StartStage("candidates", round);
 					{
 						std::vector<std::unique_ptr<tbb::tbb_thread> > workerThread(threads);
 						for (size_t i = 0; i < workerThread.size(); i++)
 						{
 							CandidateCheckingWorker worker(vertexLength,
 								cFilter,
+								filterSampled ? &sample : 0,
 								*taskQueue[i],
-								tmpDirName,
-								marks,
+								candidateDirName,
 								round,
 								error,
 								errorMutex,
-								ioTime);
+								metrics_);
 
 							workerThread[i].reset(new tbb::tbb_thread(worker));
 						}
 
-						DistributeTasks(fileName, vertexLength + 1, taskQueue, error, errorMutex, logFile);
+						DistributeTasks(input, vertexLength + 1, taskQueue, error, errorMutex, metrics_, logFile, 0, firstRecord, reader, consumer);
 						for (size_t i = 0; i < taskQueue.size(); i++)
 						{
 							workerThread[i]->join();
@@ -304,10 +501,18 @@ namespace TwoPaCo
 						}
 					}
 
-					logStream << time(0) - mark << "\t" << std::endl;
+					logStream << metrics_.FinishStage() << "\t" << std::endl;
+					metrics_.SetMemory(Metrics::EDGE_FILTER, 0);
 				}
 
-				mark = time(0);
+				uint64_t marks = metrics_.GetLastStage(Metrics::CANDIDATE_MARKS);
+				//A probe that is a false positive marks at most one extra candidate
+				uint64_t sampledProbes = metrics_.GetLastStage(Metrics::SAMPLED_PROBES);
+				uint64_t sampledNegatives = metrics_.GetLastStage(Metrics::SAMPLED_NEGATIVES);
+				uint64_t sampledFalsePositives = metrics_.GetLastStage(Metrics::SAMPLED_FALSE_POSITIVES);
+				double falsePositiveRate = sampledNegatives > 0 ? double(sampledFalsePositives) / sampledNegatives : 0;
+				uint64_t falseCandidates = sampledProbes > 0 ? min(marks, metrics_.GetLastStage(Metrics::FILTER_PROBES) * sampledFalsePositives / sampledProbes) : 0;
+				metrics_.StartStage("filtering", round);
 				tbb::spin_rw_mutex mutex;
 				logStream << "2\t";
 				OccurenceSet occurenceSet(1 << 20);
@@ -320,16 +525,16 @@ namespace TwoPaCo
 							*taskQueue[i],
 							occurenceSet,
 							mutex,
-							tmpDirName,
+							candidateDirName,
 							round,
 							error,
 							errorMutex,
-							ioTime);
+							metrics_);
 
 						workerThread[i].reset(new tbb::tbb_thread(worker));
 					}
 
-					DistributeTasks(fileName, vertexLength + 1, taskQueue, error, errorMutex, logFile);
+					DistributeTasks(input, vertexLength + 1, taskQueue, error, errorMutex, metrics_, logFile, 0, firstRecord, reader, consumer);
 					for (size_t i = 0; i < taskQueue.size(); i++)
 					{
 						workerThread[i]->join();
@@ -340,22 +545,97 @@ namespace TwoPaCo
 						throw std::runtime_error(*error);
 					}
 
-					logStream << time(0) - mark << "\t";
+					metrics_.SetMemory(Metrics::OCCURENCE_SET, OccurenceSetBytes(occurenceSet));
+					logStream << metrics_.FinishStage() << "\t";
+				}
+
+				if (oldStorage)
+				{
+					metrics_.StartStage("revisit", round);
+					EraseExisting(occurenceSet, *oldStorage);
+					tbb::mutex revisitMutex;
+					SequenceManifest revisitedManifest;
+					{
+						std::vector<std::unique_ptr<tbb::tbb_thread> > workerThread(threads);
+						for (size_t i = 0; i < workerThread.size(); i++)
+						{
+							RevisitWorker worker(hashFunctionSeed_,
+								vertexLength,
+								*taskQueue[i],
+								occurenceSet,
+								revisit,
+								revisitMutex,
+								metrics_);
+
+							workerThread[i].reset(new tbb::tbb_thread(worker));
+						}
+
+						DistributeTasks(ManifestFiles(oldManifest), vertexLength + 1, taskQueue, error, errorMutex, metrics_, logFile, &revisitedManifest);
+						for (size_t i = 0; i < taskQueue.size(); i++)
+						{
+							workerThread[i]->join();
+						}
+					}
+
+					CheckRevisited(oldManifest, revisitedManifest);
+					logStream << metrics_.FinishStage() << "\t";
 				}
 
-				mark = time(0);
+				metrics_.StartStage("junctions", round);
 				size_t falsePositives = 0;
-				size_t truePositives = TrueBifurcations(occurenceSet, bifurcationTempWrite, vertexSize_, falsePositives);
-				logStream << time(0) - mark << std::endl;
+				uint64_t tempBytes = bifurcationTempWrite.tellp();
+				size_t truePositives = 0;
+				if (cache.Enabled())
+				{
+					{
+						std::ofstream junctionsWrite(cache.GetTempFileName(junctionsArtifact).c_str(), ios::binary);
+						uint64_t count[2] = { 0, 0 };
+						junctionsWrite.write(reinterpret_cast<const char*>(count), sizeof(count));
+						truePositives = TrueBifurcations(occurenceSet, junctionsWrite, vertexSize_, falsePositives);
+						count[0] = truePositives;
+						count[1] = falsePositives;
+						junctionsWrite.seekp(0);
+						junctionsWrite.write(reinterpret_cast<const char*>(count), sizeof(count));
+						if (!junctionsWrite)
+						{
+							throw StreamFastaParser::Exception("Can't write to the stage cache");
+						}
+					}
+
+					cache.Commit(junctionsArtifact);
+					ReadJunctions(cache.GetFileName(junctionsArtifact), bifurcationTempWrite, falsePositives);
+				}
+				else
+				{
+					truePositives = TrueBifurcations(occurenceSet, bifurcationTempWrite, vertexSize_, falsePositives);
+				}
+
+				metrics_.Add(Metrics::TRUE_JUNCTIONS, truePositives);
+				metrics_.Add(Metrics::FALSE_JUNCTIONS, falsePositives);
+				metrics_.Add(Metrics::HASH_TABLE_SIZE, occurenceSet.size());
+				metrics_.Add(Metrics::TEMP_BYTES_WRITTEN, uint64_t(bifurcationTempWrite.tellp()) - tempBytes);
+				logStream << metrics_.FinishStage() << std::endl;
 				logStream << "True junctions count = " << truePositives << std::endl;
 				logStream << "False junctions count = " << falsePositives << std::endl;
 				logStream << "Hash table size = " << occurenceSet.size() << std::endl;
 				logStream << "Candidate marks count = " << marks << std::endl;
-				logStream << "ioTime = " << ioTime << std::endl;
+				if (filterSampled)
+				{
+					logStream << "Filter false positive rate = " << falsePositiveRate << " (" << sampledFalsePositives << " of " << sampledNegatives
+						<< " sampled negative queries, " << sampledEdges << " sampled edges)" << std::endl;
+					logStream << "Predicted false candidates count = " << falseCandidates << std::endl;
+				}
+				else
+				{
+					logStream << "Filter false positive rate = n/a (the filter was not filled from scratch in this run)" << std::endl;
+					logStream << "Predicted false candidates count = n/a" << std::endl;
+				}
+				logStream << "ioTime = " << metrics_.Get(Metrics::TEMP_IO_MICROSECONDS) / 1000 << std::endl;
 				logStream << std::string(80, '-') << std::endl;
 				totalFpCount += falsePositives;
 				verticesCount += truePositives;
 				low = high + 1;
+				metrics_.SetMemory(Metrics::OCCURENCE_SET, 0);
 			}
 
 			if (rounds > 1)
@@ -363,7 +643,14 @@ namespace TwoPaCo
 				delete[] binCounter;
 			}
 
-			mark = time(0);
+			metrics_.StartStage("storage");
+			uint64_t newVerticesCount = verticesCount;
+			if (oldStorage)
+			{
+				oldStorage->WriteKeys(bifurcationTempWrite);
+				verticesCount += oldState.junctions;
+			}
+
 			std::string bifurcationTempReadName = (tmpDirName + "/bifurcations.bin");
 			bifurcationTempWrite.close();
 			{
@@ -374,18 +661,51 @@ namespace TwoPaCo
 				}
 
 				bifStorage_.Init(bifurcationTempRead, verticesCount, vertexLength, threads);
+				metrics_.SetMemory(Metrics::STORAGE_KEYS, bifStorage_.GetKeysBytes());
+				metrics_.SetMemory(Metrics::STORAGE_FILTER, bifStorage_.GetFilterBytes());
 			}
 
 			std::remove(bifurcationTempReadName.c_str());
-			logStream << "Reallocating bifurcations time: " << time(0) - mark << std::endl;
+			logStream << "Reallocating bifurcations time: " << metrics_.FinishStage() << std::endl;
 
-			mark = time(0);
+			metrics_.StartStage("edges");
 			std::atomic<uint64_t> occurence;
 			tbb::mutex currentStubVertexMutex;
 			std::atomic<uint64_t> currentPiece;
-			uint64_t currentStubVertexId = verticesCount + 42;
-			JunctionPositionWriter posWriter(outFileNamePrefix);
+			uint64_t currentStubVertexId = verticesCount + 42 + oldState.stubs;
+			JunctionPositionWriter posWriter(outFileNamePrefix, callback);
+			std::unique_ptr<MembershipTable> membershipTable;
+			if (membership)
+			{
+				SequenceManifest allManifest = oldManifest;
+				for (size_t i = 0; i < manifest.Size(); i++)
+				{
+					allManifest.Add(manifest[i]);
+				}
+
+				std::vector<uint32_t> genome;
+				uint64_t genomes = allManifest.GetGenomes(genome);
+				uint64_t bytes = MembershipTable::GetBytes(bifStorage_.GetDistinctVerticesCount(), genomes);
+				logStream << "Membership table size = " << bytes / (1 << 20) << " MB (" << genomes << " genomes)" << std::endl;
+				if (bytes > MembershipTable::GetLimit())
+				{
+					std::stringstream ss;
+					ss << "The membership table needs " << bytes / (1 << 20) << " MB, more than half of the physical memory";
+					throw std::runtime_error(ss.str());
+				}
+
+				membershipTable.reset(new MembershipTable(bifStorage_.GetDistinctVerticesCount(), genome, genomes));
+				metrics_.SetMemory(Metrics::MEMBERSHIP, membershipTable->GetBytes());
+			}
+
 			occurence = currentPiece = 0;
+			if (oldStorage)
+			{
+				occurence += WriteExisting(extendFileName, *oldStorage, oldState, revisit, posWriter, membershipTable.get());
+				logStream << "New junctions count = " << newVerticesCount << std::endl;
+				logStream << "Junctions count = " << verticesCount << std::endl;
+			}
+
 			{
 				std::vector<std::unique_ptr<tbb::tbb_thread> > workerThread(threads);
 				for (size_t i = 0; i < workerThread.size(); i++)
@@ -398,15 +718,18 @@ namespace TwoPaCo
 						occurence,
 						currentStubVertexId,
 						currentStubVertexMutex,
-						tmpDirName,
+						membershipTable.get(),
+						candidateDirName,
+						cache.Enabled(),
 						rounds,
 						error,
-						errorMutex);
+						errorMutex,
+						metrics_);
 
 					workerThread[i].reset(new tbb::tbb_thread(worker));
 				}
 
-				DistributeTasks(fileName, vertexLength + 1, taskQueue, error, errorMutex, logFile);
+				DistributeTasks(input, vertexLength + 1, taskQueue, error, errorMutex, metrics_, logFile, 0, firstRecord, reader, consumer);
 				for (size_t i = 0; i < taskQueue.size(); i++)
 				{
 					workerThread[i]->join();
@@ -418,8 +741,46 @@ namespace TwoPaCo
 				throw std::runtime_error(*error);
 			}
 
+			for (size_t i = 0; i < manifest.Size(); i++)
+			{
+				oldManifest.Add(manifest[i]);
+			}
+
+			for (size_t i = 0; i < oldManifest.Size(); i++)
+			{
+				oldManifest.SetJunctionsOffset(i, posWriter.GetChrOffset(i));
+			}
+
+			if (!outFileNamePrefix.empty())
+			{
+				oldManifest.WriteToFile(SequenceManifest::DefaultFileName(outFileNamePrefix));
+			}
+
+			if (saveState || oldStorage)
+			{
+				ExtensionState state;
+				state.vertexLength = vertexLength;
+				state.filterSize = filterSize;
+				state.hashFunctions = hashFunctions;
+				state.junctions = verticesCount;
+				state.stubs = currentStubVertexId - (verticesCount + 42);
+				state.hashVersion = VertexRollingHashSeed::VERSION;
+				SaveState(outFileNamePrefix, state);
+			}
+
+			if (membershipTable)
+			{
+				metrics_.Add(Metrics::OUTPUT_BYTES_WRITTEN, membershipTable->WriteToFile(JunctionMembershipReader::DefaultFileName(outFileNamePrefix)));
+			}
+
+			metrics_.Add(Metrics::JUNCTION_OCCURENCES, occurence);
+			metrics_.Add(Metrics::OUTPUT_BYTES_WRITTEN, posWriter.GetWritten());
 			logStream << "True marks count: " << occurence << std::endl;
-			logStream << "Edges construction time: " << time(0) - mark << std::endl;
+			logStream << "Edges construction time: " << metrics_.FinishStage() << std::endl;
+			logStream << std::string(80, '-') << std::endl;
+			metrics_.WriteMemoryTable(logStream);
+			logStream << std::string(80, '-') << std::endl;
+			metrics_.WritePipelineTable(logStream);
 			logStream << std::string(80, '-') << std::endl;
 		}
 
@@ -427,6 +788,11 @@ namespace TwoPaCo
 
 		static const size_t QUEUE_CAPACITY = 16;
 		static const uint64_t BINS_COUNT = 1 << 24;
+		//Names of the stage cache artifacts
+		static const char * const MANIFEST_ARTIFACT;
+		static const char * const BINS_ARTIFACT;
+		static const char * const FILTER_ARTIFACT;
+		static const char * const JUNCTIONS_ARTIFACT;
 
 		static bool Within(uint64_t hvalue, uint64_t low, uint64_t high)
 		{
@@ -458,35 +824,43 @@ namespace TwoPaCo
 				CuckooFilter<uint64_t, 32> & cFilter,
 				size_t vertexLength,
 				TaskQueue & taskQueue,
-				std::atomic<uint32_t> * binCounter) : binSize(binSize), cFilter(cFilter),
-				vertexLength(vertexLength), taskQueue(taskQueue), binCounter(binCounter)
+				std::atomic<uint32_t> * binCounter,
+				Metrics & metrics) : binSize(binSize), cFilter(cFilter),
+				vertexLength(vertexLength), taskQueue(taskQueue), binCounter(binCounter), metrics(metrics)
 			{
 
 			}
 
 			void operator()()
 			{
+				Metrics::Counters counters;
+				Metrics::IdleTimer idle(counters);
 				size_t edgeLength = vertexLength + 1;
 				while (true)
 				{
 					Task task;
 					if (taskQueue.try_pop(task))
 					{
+						idle.Busy();
 						if (task.start == Task::GAME_OVER)
 						{
 							break;
 						}
 
+						metrics.AddProgress(task.str.size());
+
 						if (task.str.size() < edgeLength)
 						{
 							continue;
 						}
 
+						Tracer::Span span("split task");
 						for (size_t pos = 0; pos + edgeLength - 1 < task.str.size(); ++pos)
 						{
 							bool wasSet = true;
 							string edge = task.str.substr(pos, edgeLength);
-							cFilter.Add(getCanonicalVal(edge));
+							cFilter.Add(CanonicalEdgeValue(edge));
+							counters.Add(Metrics::FILTER_INSERTS);
 							//TODO
 							/*if (!wasSet)
 							{
@@ -502,7 +876,13 @@ namespace TwoPaCo
 							}*/
 						}
 					}
+					else
+					{
+						idle.Idle();
+					}
 				}
+
+				metrics.Add(counters);
 			}
 
 		private:
@@ -511,23 +891,7 @@ namespace TwoPaCo
 			size_t vertexLength;
 			TaskQueue & taskQueue;
 			std::atomic<uint32_t> * binCounter;
-
-			uint64_t getCanonicalVal(const string& edge) {
-				string revEdge = DnaChar::ReverseCompliment(edge);
-				int comRet = edge.compare(revEdge);
-				if(comRet > 0) {
-					return convertToInt(revEdge);
-				} else {
-					return convertToInt(edge);
-				}
-			}
-			uint64_t convertToInt(const string& edge) {
-				uint64_t ret = 0;
-				for(int i = 0; i < edge.size(); i++) {
-					ret += ((DnaChar::MakeUpChar(edge[i]) & 0x03) << (2*i));
-				}
-				return ret;
-			}
+			Metrics & metrics;
 		};
 
 
@@ -536,40 +900,46 @@ namespace TwoPaCo
 		public:
 			CandidateCheckingWorker(size_t vertexLength,
 				CuckooFilter<uint64_t, 32> & cFilter,
+				const EdgeSample * sample,
 				TaskQueue & taskQueue,
 				const std::string & tmpDirectory,
-				std::atomic<uint64_t> & marksCount,
 				size_t round,
 				std::unique_ptr<std::runtime_error> & error,
 				tbb::mutex & errorMutex,
-				size_t & ioTime) : vertexLength(vertexLength), cFilter(cFilter), taskQueue(taskQueue),
-				tmpDirectory(tmpDirectory), marksCount(marksCount), error(error), errorMutex(errorMutex), round(round), ioTime(ioTime)
+				Metrics & metrics) : vertexLength(vertexLength), cFilter(cFilter), sample(sample), taskQueue(taskQueue),
+				tmpDirectory(tmpDirectory), error(error), errorMutex(errorMutex), round(round), metrics(metrics)
 			{
 
 			}
 
 			void operator()()
 			{
+				Metrics::Counters counters;
+				Metrics::IdleTimer idle(counters);
 				while (true)
 				{
 					Task task;
 					if (taskQueue.try_pop(task))
 					{
+						idle.Busy();
 						if (task.start == Task::GAME_OVER)
 						{
 							break;
 						}
 
+						metrics.AddProgress(task.str.size());
+
 						if (task.str.size() < vertexLength)
 						{
 							continue;
 						}
 
+						Tracer::Span span("candidates task");
 						CuckooFilter<uint64_t, 32> candidateFilter(Task::TASK_SIZE);
 						size_t edgeLength = vertexLength + 1;
 						if (task.str.size() >= vertexLength + 2)
 						{
-							size_t definiteCount = std::count_if(task.str.begin() + 1, task.str.begin() + vertexLength + 1, DnaChar::IsDefinite);
+							size_t definiteCount = DnaChar::CountDefinite(task.str.data() + 1, vertexLength);
 							for (size_t pos = 1;; ++pos)
 							{
 								char posPrev = task.str[pos - 1];
@@ -585,14 +955,14 @@ namespace TwoPaCo
 										char nextCh = DnaChar::LITERAL[i];
 										string prevEdge = nextCh + vertex;
 										string nextEdge = vertex + nextCh;
-										uint64_t prevEdgeVal = getCanonicalVal(prevEdge);
-										uint64_t nextEdgeVal = getCanonicalVal(nextEdge);
-										if ((nextCh == posPrev) || (cFilter.Contain(prevEdgeVal) == Status::Ok))
+										uint64_t prevEdgeVal = CanonicalEdgeValue(prevEdge);
+										uint64_t nextEdgeVal = CanonicalEdgeValue(nextEdge);
+										if ((nextCh == posPrev) || Contains(prevEdgeVal, counters))
 										{
 											++inCount;
 										}
 
-										if ((nextCh == posExtend) || (cFilter.Contain(nextEdgeVal) == Status::Ok))
+										if ((nextCh == posExtend) || Contains(nextEdgeVal, counters))
 										{
 											++outCount;
 										}
@@ -600,7 +970,7 @@ namespace TwoPaCo
 
 									if (inCount > 1 || outCount > 1)
 									{
-										++marksCount;
+										counters.Add(Metrics::CANDIDATE_MARKS);
 										if(candidateFilter.Contain(pos) != Status::Ok)
 										{
 											candidateFilter.Add(pos);
@@ -623,11 +993,11 @@ namespace TwoPaCo
 							{
 								if(candidateFilter.Size() > 0)
 								{
-									auto start = std::chrono::system_clock::now();
+									Tracer::Span span("write candidates");
+									Metrics::Timer timer;
 									candidateFilter.writeToFile(CandidateMaskFileName(tmpDirectory, task.seqId, task.start, round));
-									auto end = std::chrono::system_clock::now();
-									std::chrono::duration<double, std::milli> elapsed_mseconds = end - start;
-									ioTime += elapsed_mseconds.count();
+									counters.Add(Metrics::TEMP_IO_MICROSECONDS, timer.Microseconds());
+									counters.Add(Metrics::TEMP_FILES_WRITTEN);
 								}
 							}
 							catch (std::runtime_error & err)
@@ -636,34 +1006,40 @@ namespace TwoPaCo
 							}
 						}
 					}
+					else
+					{
+						idle.Idle();
+					}
 				}
+
+				metrics.Add(counters);
 			}
 
 		private:
 			size_t vertexLength;
 			CuckooFilter<uint64_t, 32> & cFilter;
+			const EdgeSample * sample;
 			TaskQueue & taskQueue;
 			const std::string & tmpDirectory;
-			std::atomic<uint64_t> & marksCount;
 			size_t round;
 			std::unique_ptr<std::runtime_error> & error;
 			tbb::mutex & errorMutex;
-			size_t & ioTime;
-
-			uint64_t getCanonicalVal(const string& edge) {
-				string revEdge = DnaChar::ReverseCompliment(edge);
-				int comRet = edge.compare(revEdge);
-				if(comRet > 0) {
-					return convertToInt(revEdge);
-				} else {
-					return convertToInt(edge);
-				}
-			}
-			uint64_t convertToInt(const string& edge) {
-				uint64_t ret = 0;
-				for(int i = 0; i < edge.size(); i++) {
-					ret += ((DnaChar::MakeUpChar(edge[i]) & 0x03) << (2*i));
+			Metrics & metrics;
+
+			bool Contains(uint64_t edgeVal, Metrics::Counters & counters)
+			{
+				counters.Add(Metrics::FILTER_PROBES);
+				bool ret = cFilter.Contain(edgeVal) == Status::Ok;
+				if (sample != 0 && EdgeSample::Sampled(edgeVal))
+				{
+					counters.Add(Metrics::SAMPLED_PROBES);
+					if (!sample->Contains(edgeVal))
+					{
+						counters.Add(Metrics::SAMPLED_NEGATIVES);
+						counters.Add(Metrics::SAMPLED_FALSE_POSITIVES, ret ? 1 : 0);
+					}
 				}
+
 				return ret;
 			}
 		};
@@ -682,25 +1058,30 @@ namespace TwoPaCo
 				size_t round,
 				std::unique_ptr<std::runtime_error> & error,
 				tbb::mutex & errorMutex,
-				size_t & ioTime) : hashFunction(hashFunction), vertexLength(vertexLength), taskQueue(taskQueue),
+				Metrics & metrics) : hashFunction(hashFunction), vertexLength(vertexLength), taskQueue(taskQueue),
 				 occurenceSet(occurenceSet), mutex(mutex), tmpDirectory(tmpDirectory), round(round), error(error),
-				 errorMutex(errorMutex), ioTime(ioTime)
+				 errorMutex(errorMutex), metrics(metrics)
 			{
 
 			}
 
 			void operator()()
 			{
+				Metrics::Counters counters;
+				Metrics::IdleTimer idle(counters);
 				while (true)
 				{
 					Task task;
 					if (taskQueue.try_pop(task))
 					{
+						idle.Busy();
 						if (task.start == Task::GAME_OVER)
 						{
 							break;
 						}
 
+						metrics.AddProgress(task.str.size());
+
 						if (task.str.size() < vertexLength)
 						{
 							continue;
@@ -709,15 +1090,16 @@ namespace TwoPaCo
 						size_t edgeLength = vertexLength + 1;
 						if (task.str.size() >= vertexLength + 2)
 						{
+							Tracer::Span span("filtering task");
 							VertexRollingHash hash(hashFunction, task.str.begin() + 1, 1);
 							CuckooFilter<uint64_t, 32> candidateFilter(Task::TASK_SIZE);
 							try
 							{
-								auto start = std::chrono::system_clock::now();
+								Tracer::Span span("read candidates");
+								Metrics::Timer timer;
 								candidateFilter.readFromFile(CandidateMaskFileName(tmpDirectory, task.seqId, task.start, round), false);
-								auto end = std::chrono::system_clock::now();
-								std::chrono::duration<double, std::milli> elapsed_mseconds = end - start;
-								ioTime += elapsed_mseconds.count();
+								counters.Add(Metrics::TEMP_IO_MICROSECONDS, timer.Microseconds());
+								counters.Add(Metrics::TEMP_FILES_READ);
 							}
 							catch (std::runtime_error & err)
 							{
@@ -741,6 +1123,7 @@ namespace TwoPaCo
 									size_t inUnknownCount = now.Prev() == 'N' ? 1 : 0;
 									size_t outUnknownCount = now.Next() == 'N' ? 1 : 0;
 									auto ret = occurenceSet.insert(now);
+									counters.Add(Metrics::HASH_TABLE_INSERTS, ret.second ? 1 : 0);
 									typename OccurenceSet::iterator it = ret.first;
 									if (!ret.second && !it->IsBifurcation())
 									{
@@ -766,7 +1149,13 @@ namespace TwoPaCo
 							}
 						}
 					}
+					else
+					{
+						idle.Idle();
+					}
 				}
+
+				metrics.Add(counters);
 			}
 
 		private:
@@ -779,7 +1168,7 @@ namespace TwoPaCo
 			size_t round;
 			std::unique_ptr<std::runtime_error> & error;
 			tbb::mutex & errorMutex;
-			size_t & ioTime;
+			Metrics & metrics;
 		};
 
 		struct EdgeResult
@@ -788,9 +1177,15 @@ namespace TwoPaCo
 			std::vector<JunctionPosition> junction;
 		};
 
+		static int64_t EdgeResultBytes(const EdgeResult & result)
+		{
+			return sizeof(EdgeResult) + result.junction.capacity() * sizeof(JunctionPosition);
+		}
+
 		static bool FlushEdgeResults(std::deque<EdgeResult> & result,
 			JunctionPositionWriter & writer,
-			std::atomic<uint64_t> & currentPiece)
+			std::atomic<uint64_t> & currentPiece,
+			Metrics & metrics)
 		{
 			if (result.size() > 0 && result.front().pieceId == currentPiece)
 			{
@@ -800,6 +1195,7 @@ namespace TwoPaCo
 				}
 
 				++currentPiece;
+				metrics.AddMemory(Metrics::EDGE_RESULTS, -EdgeResultBytes(result.front()));
 				result.pop_front();
 				return true;
 			}
@@ -818,32 +1214,41 @@ namespace TwoPaCo
 				std::atomic<uint64_t> & occurences,
 				uint64_t & currentStubVertexId,
 				tbb::mutex & currentStubVertexMutex,
+				MembershipTable * membership,
 				const std::string & tmpDirectory,
+				bool keepCandidates,
 				size_t totalRounds,
 				std::unique_ptr<std::runtime_error> & error,
-				tbb::mutex & errorMutex) : vertexLength(vertexLength), taskQueue(taskQueue), bifStorage(bifStorage),writer(writer),
-				currentPiece(currentPiece), occurences(occurences), tmpDirectory(tmpDirectory), error(error), errorMutex(errorMutex),
-				currentStubVertexId(currentStubVertexId), currentStubVertexMutex(currentStubVertexMutex), totalRounds(totalRounds)
+				tbb::mutex & errorMutex,
+				Metrics & metrics) : vertexLength(vertexLength), taskQueue(taskQueue), currentStubVertexId(currentStubVertexId), bifStorage(bifStorage), writer(writer),
+				currentPiece(currentPiece), occurences(occurences), tmpDirectory(tmpDirectory), keepCandidates(keepCandidates), error(error), totalRounds(totalRounds),
+				errorMutex(errorMutex), currentStubVertexMutex(currentStubVertexMutex), membership(membership), metrics(metrics)
 			{
 
 			}
 
 			void operator()()
 			{
+				Metrics::Counters counters;
+				Metrics::IdleTimer idle(counters);
 				try
 				{
 					DnaString bitBuf;
 					std::deque<EdgeResult> result;
+					std::unique_ptr<MembershipTable::Buffer> membershipBuffer(membership != 0 ? new MembershipTable::Buffer(*membership) : 0);
 					while (true)
 					{
 						Task task;
 						if (taskQueue.try_pop(task))
 						{
+							idle.Busy();
 							if (task.start == Task::GAME_OVER)
 							{
 								break;
 							}
 
+							metrics.AddProgress(task.str.size());
+
 							if (task.str.size() < vertexLength)
 							{
 								continue;
@@ -852,13 +1257,18 @@ namespace TwoPaCo
 							size_t edgeLength = vertexLength + 1;
 							if (task.str.size() >= vertexLength + 2)
 							{
+								Tracer::Span span("edges task");
 								CuckooFilter<uint64_t, 32> candidateFilter(Task::TASK_SIZE);
 								try
 								{
 									for (size_t i = 0; i < totalRounds; i++)
 									{
 										CuckooFilter<uint64_t, 32> tempFilter(Task::TASK_SIZE);
-										tempFilter.readFromFile(CandidateMaskFileName(tmpDirectory, task.seqId, task.start, i), true);
+										Tracer::Span span("read candidates");
+										Metrics::Timer timer;
+										tempFilter.readFromFile(CandidateMaskFileName(tmpDirectory, task.seqId, task.start, i), !keepCandidates);
+										counters.Add(Metrics::TEMP_IO_MICROSECONDS, timer.Microseconds());
+										counters.Add(Metrics::TEMP_FILES_READ);
 										for(size_t pos = 0; pos < task.str.size(); pos++)
 										{
 											if(tempFilter.Contain(pos) == Status::Ok)
@@ -875,10 +1285,10 @@ namespace TwoPaCo
 
 								EdgeResult currentResult;
 								currentResult.pieceId = task.piece;
-								size_t definiteCount = std::count_if(task.str.begin() + 1, task.str.begin() + vertexLength + 1, DnaChar::IsDefinite);
+								size_t definiteCount = DnaChar::CountDefinite(task.str.data() + 1, vertexLength);
 								for (size_t pos = 1;; ++pos)
 								{
-									while (result.size() > 0 && FlushEdgeResults(result, writer, currentPiece));
+									while (result.size() > 0 && FlushEdgeResults(result, writer, currentPiece, metrics));
 									int64_t bifId(INVALID_VERTEX);
 									assert(definiteCount == std::count_if(task.str.begin() + pos, task.str.begin() + pos + vertexLength, DnaChar::IsDefinite));
 									if (definiteCount == vertexLength && (candidateFilter.Contain(pos) == Status::Ok))
@@ -888,6 +1298,10 @@ namespace TwoPaCo
 										{
 											occurences++;
 											currentResult.junction.push_back(JunctionPosition(task.seqId, task.start + pos - 1, bifId));
+											if (membershipBuffer)
+											{
+												membershipBuffer->Add(bifId, task.seqId);
+											}
 										}
 									}
 
@@ -909,14 +1323,19 @@ namespace TwoPaCo
 									}
 								}
 
-								result.push_back(currentResult);
+								metrics.AddMemory(Metrics::EDGE_RESULTS, EdgeResultBytes(currentResult));
+								result.push_back(std::move(currentResult));
 							}
 						}
+						else
+						{
+							idle.Idle();
+						}
 					}
 
 					while (result.size() > 0)
 					{
-						FlushEdgeResults(result, writer, currentPiece);
+						FlushEdgeResults(result, writer, currentPiece, metrics);
 					}
 				}
 				catch (std::runtime_error & e)
@@ -925,6 +1344,8 @@ namespace TwoPaCo
 					error.reset(new std::runtime_error(e));
 					errorMutex.unlock();
 				}
+
+				metrics.Add(counters);
 			}
 
 		private:
@@ -936,10 +1357,13 @@ namespace TwoPaCo
 			std::atomic<uint64_t> & currentPiece;
 			std::atomic<uint64_t> & occurences;
 			const std::string & tmpDirectory;
+			bool keepCandidates;
 			std::unique_ptr<std::runtime_error> & error;
 			size_t totalRounds;
 			tbb::mutex & errorMutex;
 			tbb::mutex & currentStubVertexMutex;
+			MembershipTable * membership;
+			Metrics & metrics;
 		};
 
 		class FilterFillerWorker
@@ -948,13 +1372,17 @@ namespace TwoPaCo
 			FilterFillerWorker(
 				size_t edgeLength,
 				CuckooFilter<uint64_t, 32> & cFilter,
-				TaskQueue & taskQueue) : cFilter(cFilter), taskQueue(taskQueue), edgeLength(edgeLength)
+				EdgeSample & sample,
+				TaskQueue & taskQueue,
+				Metrics & metrics) : cFilter(cFilter), sample(sample), taskQueue(taskQueue), edgeLength(edgeLength), metrics(metrics)
 			{
 
 			}
 
 			void operator()()
 			{
+				Metrics::Counters counters;
+				Metrics::IdleTimer idle(counters);
 				const char DUMMY_CHAR = DnaChar::LITERAL[0];
 				const char REV_DUMMY_CHAR = DnaChar::ReverseChar(DUMMY_CHAR);
 				while (true)
@@ -962,18 +1390,22 @@ namespace TwoPaCo
 					Task task;
 					if (taskQueue.try_pop(task))
 					{
+						idle.Busy();
 						if (task.start == Task::GAME_OVER)
 						{
 							break;
 						}
 
+						metrics.AddProgress(task.str.size());
+
 						if (task.str.size() < edgeLength)
 						{
 							continue;
 						}
 
+						Tracer::Span span("filling task");
 						size_t vertexLength = edgeLength - 1;
-						size_t definiteCount = std::count_if(task.str.begin(), task.str.begin() + vertexLength, DnaChar::IsDefinite);
+						size_t definiteCount = DnaChar::CountDefinite(task.str.data(), vertexLength);
 
 						for (size_t pos = 0;; ++pos)
 						{
@@ -986,42 +1418,22 @@ namespace TwoPaCo
 								if (DnaChar::IsDefinite(nextCh))
 								{
 									string edge = vertex + nextCh;
-									uint64_t edgeVal = getCanonicalVal(edge);
-									if(cFilter.Contain(edgeVal) != Status::Ok)
-									{
-										cFilter.Add(edgeVal);
-									}
+									Insert(CanonicalEdgeValue(edge), counters);
 								}
 								else
 								{
 									string edge = vertex + DUMMY_CHAR;
-									uint64_t edgeVal = getCanonicalVal(edge);
-									if(cFilter.Contain(edgeVal) != Status::Ok)
-									{
-										cFilter.Add(edgeVal);
-									}
+									Insert(CanonicalEdgeValue(edge), counters);
 									edge = vertex + REV_DUMMY_CHAR;
-									edgeVal = getCanonicalVal(edge);
-									if(cFilter.Contain(edgeVal) != Status::Ok)
-									{
-										cFilter.Add(edgeVal);
-									}
+									Insert(CanonicalEdgeValue(edge), counters);
 
 								}
 								if (pos > 0 && !DnaChar::IsDefinite(task.str[pos - 1]))
 								{
 									string edge = DUMMY_CHAR + vertex;
-									uint64_t edgeVal = getCanonicalVal(edge);
-									if(cFilter.Contain(edgeVal) != Status::Ok)
-									{
-										cFilter.Add(edgeVal);
-									}
+									Insert(CanonicalEdgeValue(edge), counters);
 									edge = REV_DUMMY_CHAR + vertex;
-									edgeVal = getCanonicalVal(edge);
-									if(cFilter.Contain(edgeVal) != Status::Ok)
-									{
-										cFilter.Add(edgeVal);
-									}
+									Insert(CanonicalEdgeValue(edge), counters);
 								}
 							}
 
@@ -1035,127 +1447,540 @@ namespace TwoPaCo
 							}
 						}
 					}
+					else
+					{
+						idle.Idle();
+					}
 				}
+
+				metrics.Add(counters);
 			}
 
 		private:
 			size_t edgeLength;
 			CuckooFilter<uint64_t, 32> & cFilter;
+			EdgeSample & sample;
 			TaskQueue & taskQueue;
+			Metrics & metrics;
+
+			void Insert(uint64_t edgeVal, Metrics::Counters & counters)
+			{
+				if (EdgeSample::Sampled(edgeVal))
+				{
+					sample.Add(edgeVal);
+				}
 
-			uint64_t getCanonicalVal(const string& edge) {
-				string revEdge = DnaChar::ReverseCompliment(edge);
-				int comRet = edge.compare(revEdge);
-				if(comRet > 0) {
-					return convertToInt(revEdge);
-				} else {
-					return convertToInt(edge);
+				counters.Add(Metrics::FILTER_PROBES);
+				if (cFilter.Contain(edgeVal) != Status::Ok)
+				{
+					counters.Add(Metrics::FILTER_INSERTS);
+					cFilter.Add(edgeVal);
 				}
 			}
-			uint64_t convertToInt(const string& edge) {
-				uint64_t ret = 0;
-				for(int i = 0; i < edge.size(); i++) {
-					ret += ((DnaChar::MakeUpChar(edge[i]) & 0x03) << (2*i));
+		};
+
+
+		//Parameters and sizes of a construction saved to extend its graph later
+		struct ExtensionState
+		{
+			uint64_t vertexLength;
+			uint64_t filterSize;
+			uint64_t hashFunctions;
+			uint64_t junctions;
+			uint64_t stubs;
+			uint64_t hashVersion;
+			ExtensionState() : vertexLength(0), filterSize(0), hashFunctions(0), junctions(0), stubs(0), hashVersion(0) {}
+		};
+
+		//An occurence of a candidate from the new genomes in the existing ones
+		struct Revisit
+		{
+			uint32_t chr;
+			uint32_t pos;
+			bool positive;
+			const Occurence * occurence;
+			Revisit(uint32_t chr, uint32_t pos, bool positive, const Occurence * occurence) : chr(chr), pos(pos), positive(positive), occurence(occurence) {}
+			bool operator < (const Revisit & other) const
+			{
+				return std::make_pair(chr, pos) < std::make_pair(other.chr, other.pos);
+			}
+		};
+
+		static std::string StateFileName(const std::string & junctionsFileName)
+		{
+			return junctionsFileName + ".state";
+		}
+
+		static std::string FilterFileName(const std::string & junctionsFileName)
+		{
+			return junctionsFileName + ".filter";
+		}
+
+		static std::string KeysFileName(const std::string & junctionsFileName)
+		{
+			return junctionsFileName + ".junctions";
+		}
+
+		void SaveState(const std::string & junctionsFileName, const ExtensionState & state) const
+		{
+			std::ofstream keys(KeysFileName(junctionsFileName).c_str(), ios::binary);
+			bifStorage_.WriteKeys(keys);
+			std::ofstream out(StateFileName(junctionsFileName).c_str());
+			out << state.vertexLength << '\t' << state.filterSize << '\t' << state.hashFunctions << '\t' << state.junctions << '\t' << state.stubs << '\t' << state.hashVersion << std::endl;
+			if (!out)
+			{
+				throw std::runtime_error("Can't write the state file");
+			}
+		}
+
+		static std::unique_ptr<BifurcationStorage<CAPACITY> > LoadState(const std::string & junctionsFileName,
+			size_t vertexLength,
+			size_t filterSize,
+			size_t hashFunctions,
+			size_t threads,
+			ExtensionState & state,
+			SequenceManifest & manifest)
+		{
+			std::ifstream in(StateFileName(junctionsFileName).c_str());
+			if (!(in >> state.vertexLength >> state.filterSize >> state.hashFunctions >> state.junctions >> state.stubs >> state.hashVersion))
+			{
+				throw std::runtime_error("Can't read the state of " + junctionsFileName + ", it must be built with --extendable");
+			}
+
+			if (state.vertexLength != vertexLength || state.filterSize != filterSize || state.hashFunctions != hashFunctions)
+			{
+				throw std::runtime_error("The graph must be extended with the same k, filter size and number of hash functions");
+			}
+
+			if (state.hashVersion != VertexRollingHashSeed::VERSION)
+			{
+				throw std::runtime_error("The graph was built with other hash functions, it must be rebuilt with --extendable");
+			}
+
+			if (!manifest.ReadFromFile(SequenceManifest::DefaultFileName(junctionsFileName)))
+			{
+				throw std::runtime_error("Can't read the manifest of " + junctionsFileName);
+			}
+
+			std::ifstream keys(KeysFileName(junctionsFileName).c_str(), ios::binary);
+			if (!keys)
+			{
+				throw std::runtime_error("Can't read the junctions of " + junctionsFileName);
+			}
+
+			std::unique_ptr<BifurcationStorage<CAPACITY> > ret(new BifurcationStorage<CAPACITY>());
+			ret->Init(keys, state.junctions, vertexLength, threads);
+			return ret;
+		}
+
+		static void WriteBins(const std::string & fileName, const std::atomic<uint32_t> * binCounter)
+		{
+			std::vector<uint32_t> bin(binCounter, binCounter + BINS_COUNT);
+			std::ofstream out(fileName.c_str(), ios::binary);
+			out.write(reinterpret_cast<const char*>(&bin[0]), bin.size() * sizeof(bin[0]));
+			if (!out)
+			{
+				throw StreamFastaParser::Exception("Can't write to the stage cache");
+			}
+		}
+
+		static void ReadBins(const std::string & fileName, std::atomic<uint32_t> * binCounter)
+		{
+			std::vector<uint32_t> bin(BINS_COUNT);
+			std::ifstream in(fileName.c_str(), ios::binary);
+			in.read(reinterpret_cast<char*>(&bin[0]), bin.size() * sizeof(bin[0]));
+			if (!in)
+			{
+				throw StreamFastaParser::Exception("The stage cache is corrupted");
+			}
+
+			std::copy(bin.begin(), bin.end(), binCounter);
+		}
+
+		//Appends the junctions of a round kept in the cache to the output, returns
+		//their number
+		static uint64_t ReadJunctions(const std::string & fileName, std::ofstream & out, uint64_t & falsePositives)
+		{
+			std::ifstream in(fileName.c_str(), ios::binary);
+			uint64_t count[2];
+			in.read(reinterpret_cast<char*>(count), sizeof(count));
+			if (!in)
+			{
+				throw StreamFastaParser::Exception("The stage cache is corrupted");
+			}
+
+			if (count[0] > 0)
+			{
+				out << in.rdbuf();
+			}
+
+			if (!out)
+			{
+				throw StreamFastaParser::Exception("Can't write to a temporary file");
+			}
+
+			falsePositives = count[1];
+			return count[0];
+		}
+
+		//The input files in the order of the records
+		static std::vector<std::string> ManifestFiles(const SequenceManifest & manifest)
+		{
+			std::vector<std::string> ret;
+			for (size_t i = 0; i < manifest.Size(); i++)
+			{
+				if (ret.empty() || ret.back() != manifest[i].fileName)
+				{
+					ret.push_back(manifest[i].fileName);
 				}
-				return ret;
 			}
+
+			return ret;
+		}
+
+		static void CheckRevisited(const SequenceManifest & expected, const SequenceManifest & revisited)
+		{
+			bool same = expected.Size() == revisited.Size();
+			for (size_t i = 0; same && i < expected.Size(); i++)
+			{
+				same = expected[i].length == revisited[i].length && expected[i].header == revisited[i].header;
+			}
+
+			if (!same)
+			{
+				throw std::runtime_error("The genomes of the extended graph have changed");
+			}
+		}
+
+		//Junctions of the existing graph remain junctions and their occurences are already known
+		static void EraseExisting(OccurenceSet & occurenceSet, const BifurcationStorage<CAPACITY> & oldStorage)
+		{
+			for (auto it = occurenceSet.begin(); it != occurenceSet.end();)
+			{
+				if (oldStorage.GetIndex(it->GetBase()) != INVALID_VERTEX)
+				{
+					it = occurenceSet.unsafe_erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+
+		//Checks the neighbours of the candidates in the existing genomes and keeps their positions,
+		//no candidates are inserted, so the set is only read
+		class RevisitWorker
+		{
+		public:
+			RevisitWorker(const VertexRollingHashSeed & hashFunction,
+				size_t vertexLength,
+				TaskQueue & taskQueue,
+				const OccurenceSet & occurenceSet,
+				std::vector<Revisit> & revisit,
+				tbb::mutex & revisitMutex,
+				Metrics & metrics) : hashFunction(hashFunction), vertexLength(vertexLength), taskQueue(taskQueue),
+				occurenceSet(occurenceSet), revisit(revisit), revisitMutex(revisitMutex), metrics(metrics)
+			{
+
+			}
+
+			void operator()()
+			{
+				Metrics::Counters counters;
+				Metrics::IdleTimer idle(counters);
+				std::vector<Revisit> found;
+				size_t edgeLength = vertexLength + 1;
+				while (true)
+				{
+					Task task;
+					if (taskQueue.try_pop(task))
+					{
+						idle.Busy();
+						if (task.start == Task::GAME_OVER)
+						{
+							break;
+						}
+
+						metrics.AddProgress(task.str.size());
+
+						if (task.str.size() < vertexLength + 2)
+						{
+							continue;
+						}
+
+						Tracer::Span span("revisit task");
+						VertexRollingHash hash(hashFunction, task.str.begin() + 1, 1);
+						size_t definiteCount = DnaChar::CountDefinite(task.str.data() + 1, vertexLength);
+						for (size_t pos = 1;; ++pos)
+						{
+							char posPrev = task.str[pos - 1];
+							char posExtend = task.str[pos + vertexLength];
+							if (definiteCount == vertexLength)
+							{
+								Occurence now;
+								uint64_t posHash0 = hash.RawPositiveHash(0);
+								uint64_t negHash0 = hash.RawNegativeHash(0);
+								now.Set(posHash0, negHash0, task.str.begin() + pos, vertexLength, posExtend, posPrev, false);
+								counters.Add(Metrics::HASH_TABLE_PROBES);
+								auto it = occurenceSet.find(now);
+								if (it != occurenceSet.end())
+								{
+									size_t inUnknownCount = (now.Prev() == 'N' ? 1 : 0) + (DnaChar::IsDefinite(it->Prev()) ? 0 : 1);
+									size_t outUnknownCount = (now.Next() == 'N' ? 1 : 0) + (DnaChar::IsDefinite(it->Next()) ? 0 : 1);
+									if (!it->IsBifurcation() && (it->Next() != now.Next() || it->Prev() != now.Prev() || inUnknownCount > 1 || outUnknownCount > 1))
+									{
+										it->MakeBifurcation();
+									}
+
+									//The same choice of the strand as in Set, the key is the forward string
+									bool positive = posHash0 < negHash0 || (posHash0 == negHash0 && DnaChar::LessSelfReverseComplement(task.str.begin() + pos, vertexLength));
+									found.push_back(Revisit(uint32_t(task.seqId), uint32_t(task.start + pos - 1), positive, &*it));
+								}
+							}
+
+							if (pos + edgeLength < task.str.size())
+							{
+								definiteCount += (DnaChar::IsDefinite(task.str[pos + vertexLength]) ? 1 : 0) - (DnaChar::IsDefinite(task.str[pos]) ? 1 : 0);
+								hash.Update(task.str[pos], posExtend);
+							}
+							else
+							{
+								break;
+							}
+						}
+					}
+					else
+					{
+						idle.Idle();
+					}
+				}
+
+				revisitMutex.lock();
+				revisit.insert(revisit.end(), found.begin(), found.end());
+				revisitMutex.unlock();
+				metrics.Add(counters);
+			}
+
+		private:
+			const VertexRollingHashSeed & hashFunction;
+			size_t vertexLength;
+			TaskQueue & taskQueue;
+			const OccurenceSet & occurenceSet;
+			std::vector<Revisit> & revisit;
+			tbb::mutex & revisitMutex;
+			Metrics & metrics;
 		};
 
+		//Copies the junctions of the existing genomes with the identifiers of the new storage,
+		//the occurences of the new junctions in the existing genomes are merged in
+		uint64_t WriteExisting(const std::string & junctionsFileName,
+			const BifurcationStorage<CAPACITY> & oldStorage,
+			const ExtensionState & oldState,
+			std::vector<Revisit> & revisit,
+			JunctionPositionWriter & writer,
+			MembershipTable * membership) const
+		{
+			Tracer::Span span("write existing");
+			std::unique_ptr<MembershipTable::Buffer> membershipBuffer(membership != 0 ? new MembershipTable::Buffer(*membership) : 0);
+			auto write = [&](const JunctionPosition & pos)
+			{
+				writer.WriteJunction(pos);
+				if (membershipBuffer)
+				{
+					membershipBuffer->Add(pos.GetId(), pos.GetChr());
+				}
+			};
+
+			std::vector<JunctionPosition> added;
+			for (const Revisit & now : revisit)
+			{
+				if (now.occurence->IsBifurcation())
+				{
+					int64_t id = bifStorage_.GetIndex(now.occurence->GetBase()) + 1;
+					added.push_back(JunctionPosition(now.chr, now.pos, now.positive ? id : -id));
+				}
+			}
+
+			std::vector<Revisit>().swap(revisit);
+			std::sort(added.begin(), added.end(), [](const JunctionPosition & a, const JunctionPosition & b)
+			{
+				return std::make_pair(a.GetChr(), a.GetPos()) < std::make_pair(b.GetChr(), b.GetPos());
+			});
+
+			uint64_t ret = 0;
+			JunctionPosition pos;
+			auto next = added.begin();
+			uint64_t junctions = bifStorage_.GetDistinctVerticesCount();
+			JunctionPositionReader reader(junctionsFileName);
+			while (reader.NextJunctionPosition(pos))
+			{
+				for (; next != added.end() && std::make_pair(next->GetChr(), next->GetPos()) < std::make_pair(pos.GetChr(), pos.GetPos()); ++next, ++ret)
+				{
+					write(*next);
+				}
+
+				if (next != added.end() && next->GetChr() == pos.GetChr() && next->GetPos() == pos.GetPos())
+				{
+					//A sequence end that became a junction
+					write(*next++);
+				}
+				else if (uint64_t(std::abs(pos.GetId())) <= oldState.junctions)
+				{
+					int64_t id = bifStorage_.GetIndex(oldStorage.GetKey(std::abs(pos.GetId()) - 1)) + 1;
+					write(JunctionPosition(pos.GetChr(), pos.GetPos(), pos.GetId() > 0 ? id : -id));
+				}
+				else
+				{
+					write(JunctionPosition(pos.GetChr(), pos.GetPos(), pos.GetId() - oldState.junctions + junctions));
+				}
 
-		static void DistributeTasks(const std::vector<std::string> & fileName,
+				++ret;
+			}
+
+			for (; next != added.end(); ++next, ++ret)
+			{
+				write(*next);
+			}
+
+			return ret;
+		}
+
+		//Splits the input into tasks for the workers. With a shared reader the input is
+		//not parsed, the chunks of the reader are cut down to the overlap instead
+		static void DistributeTasks(const FastaInput & input,
 			size_t overlapSize,
 			std::vector<TaskQueuePtr> & taskQueue,
 			std::unique_ptr<std::runtime_error> & error,
 			tbb::mutex & errorMutex,
-			std::ostream & logFile)
+			Metrics & metrics,
+			std::ostream & logFile,
+			SequenceManifest * manifest = 0,
+			size_t firstRecord = 0,
+			SharedReader * reader = 0,
+			size_t consumer = 0)
 		{
-			size_t record = 0;
+			Metrics::Counters counters;
+			uint64_t blockedStart = 0;
 			size_t nowQueue = 0;
 			uint32_t pieceCount = 0;
 #ifdef LOGGING
 			logFile << "Starting a new stage" << std::endl;
 #endif
-			for (size_t file = 0; file < fileName.size(); file++)
+			auto onChunk = [&](uint64_t record, uint64_t start, bool isFinal, std::string && str)
 			{
-#ifdef LOGGING
-				logFile << "Reading " << fileName[file] << std::endl;
-#endif
-				const std::string & nowFileName = fileName[file];
-				for (StreamFastaParser parser(nowFileName); parser.ReadRecord(); record++)
 				{
+					errorMutex.lock();
+					if (error != 0)
 					{
-						errorMutex.lock();
-						if (error != 0)
-						{
-							throw *error;
-						}
-
-						errorMutex.unlock();
+						throw *error;
 					}
 
-					std::stringstream ss;
+					errorMutex.unlock();
+				}
+
+				for (bool found = false; !found; nowQueue = nowQueue + 1 < taskQueue.size() ? nowQueue + 1 : 0)
+				{
+					TaskQueuePtr & q = taskQueue[nowQueue];
+					if (q->capacity() - q->size() > 0)
+					{
+						q->push(Task(firstRecord + record, start, pieceCount++, isFinal, std::move(str)));
+						metrics.SetMemory(Metrics::TASK_QUEUES, SampleQueues(taskQueue, counters));
 #ifdef LOGGING
-					logFile << "Processing sequence " << parser.GetCurrentHeader() << " " << ss.str() << std::endl;
+						logFile << "Passed chunk " << start << " to worker " << nowQueue << std::endl;
 #endif
-					char ch;
-					uint64_t prev = 0;
-					uint64_t start = 0;
-					std::string buf = "N";
-					bool over = false;
-					do
-					{
-						over = !parser.GetChar(ch);
-						if (!over)
+						found = true;
+						if (blockedStart != 0)
 						{
-							start++;
-							buf.push_back(DnaChar::IsDefinite(ch) ? ch : 'N');
+							counters.Add(Metrics::PRODUCER_BLOCKED_MICROSECONDS, Tracer::Now() - blockedStart);
+							blockedStart = 0;
 						}
-
-						if (buf.size() >= overlapSize && (buf.size() == Task::TASK_SIZE || over))
+					}
+					else
+					{
+						counters.Add(Metrics::QUEUE_STALLS);
+						if (blockedStart == 0)
 						{
-							for (bool found = false; !found; nowQueue = nowQueue + 1 < taskQueue.size() ? nowQueue + 1 : 0)
-							{
-								TaskQueuePtr & q = taskQueue[nowQueue];
-								if (q->capacity() - q->size() > 0)
-								{
-									std::string overlap;
-									if (!over)
-									{
-										overlap.assign(buf.end() - overlapSize, buf.end());
-									}
-									else
-									{
-										buf.push_back('N');
-									}
+							blockedStart = Tracer::Now();
+						}
+					}
+				}
+			};
 
-									q->push(Task(record, prev, pieceCount++, over, std::move(buf)));
-#ifdef LOGGING
-									logFile << "Passed chunk " << prev << " to worker " << nowQueue << std::endl;
-#endif
-									prev = start - overlapSize + 1;
-									buf.swap(overlap);
-									found = true;
-								}
-							}
+			auto onRecord = [&](uint64_t, const SequenceRecord & sequence)
+			{
+				counters.Add(Metrics::INPUT_BASES, sequence.length);
+				if (manifest != 0)
+				{
+					manifest->Add(sequence);
+				}
+			};
 
+			if (reader != 0)
+			{
+				uint64_t cut = reader->GetOverlapSize() - overlapSize;
+				for (SharedReader::Chunk chunk; reader->Next(consumer, chunk);)
+				{
+					if (chunk.str)
+					{
+						//The first chunk of a sequence has no overlap and the last one is padded
+						uint64_t skip = chunk.start == 0 ? 0 : cut;
+						if (chunk.str->size() - skip - (chunk.isFinal ? 1 : 0) >= overlapSize)
+						{
+							onChunk(chunk.record, chunk.start + skip, chunk.isFinal, std::string(chunk.str->begin() + skip, chunk.str->end()));
 						}
-
-					} while (!over);
+					}
+					else
+					{
+						onRecord(chunk.record, *chunk.sequence);
+					}
 				}
 			}
+			else
+			{
+				SplitInput(input, overlapSize, overlapSize, logFile, onChunk, onRecord);
+			}
 
 			for (size_t i = 0; i < taskQueue.size(); i++)
 			{
-				TaskQueuePtr & q = taskQueue[nowQueue];
 				while (!taskQueue[i]->try_push(Task(0, Task::GAME_OVER, 0, true, std::string())))
 				{
 
 				}
 			}
+
+			metrics.Add(counters);
+			metrics.SetMemory(Metrics::TASK_QUEUES, 0);
+			if (metrics.ReportsProgress())
+			{
+				Progress::FinishInput(counters.Get(Metrics::INPUT_BASES));
+			}
+		}
+
+		//Adds the occupancy of every queue to the histogram and returns the bytes of
+		//the waiting tasks, a task holds at most TASK_SIZE characters
+		static uint64_t SampleQueues(const std::vector<TaskQueuePtr> & taskQueue, Metrics::Counters & counters)
+		{
+			uint64_t ret = 0;
+			for (const TaskQueuePtr & q : taskQueue)
+			{
+				size_t size = max(q->size(), std::ptrdiff_t(0));
+				counters.AddQueueSample(size, q->capacity());
+				ret += size * (sizeof(Task) + Task::TASK_SIZE);
+			}
+
+			return ret;
+		}
+
+		//Nodes of the set and its bucket array
+		static uint64_t OccurenceSetBytes(const OccurenceSet & occurenceSet)
+		{
+			return occurenceSet.size() * (sizeof(Occurence) + 2 * sizeof(void*)) + occurenceSet.unsafe_bucket_count() * sizeof(void*);
 		}
 
 		uint64_t TrueBifurcations(const OccurenceSet & occurenceSet, std::ofstream & out, size_t vertexSize, size_t & falsePositives) const
 		{
+			Tracer::Span span("true junctions");
 			uint64_t truePositives = falsePositives = 0;
 			for (auto it = occurenceSet.begin(); it != occurenceSet.end();++it)
 			{
@@ -1179,8 +2004,18 @@ namespace TwoPaCo
 		}
 
 		size_t vertexSize_;
-		DISALLOW_COPY_AND_ASSIGN(VertexEnumeratorImpl<CAPACITY>);
+		Metrics metrics_;
+		DISALLOW_COPY_AND_ASSIGN(VertexEnumeratorImpl);
 	};
+
+	template<size_t CAPACITY, bool PACKED>
+	const char * const VertexEnumeratorImpl<CAPACITY, PACKED>::MANIFEST_ARTIFACT = "manifest";
+	template<size_t CAPACITY, bool PACKED>
+	const char * const VertexEnumeratorImpl<CAPACITY, PACKED>::BINS_ARTIFACT = "bins";
+	template<size_t CAPACITY, bool PACKED>
+	const char * const VertexEnumeratorImpl<CAPACITY, PACKED>::FILTER_ARTIFACT = "filter";
+	template<size_t CAPACITY, bool PACKED>
+	const char * const VertexEnumeratorImpl<CAPACITY, PACKED>::JUNCTIONS_ARTIFACT = "junctions";
 }
 
 #endif
@@ -1,60 +1,178 @@
 #ifndef _VERTEX_ROLLING_HASH_H_
 #define _VERTEX_ROLLING_HASH_H_
 
+#include <cassert>
+
 #include <cuckoofilter/cuckoofilter.h>
 
 #include "common.h"
 #include "concurrentbitvector.h"
-#include "ngramhashing/cyclichash.h"
 
 using namespace cuckoofilter;
 
 namespace TwoPaCo
 {
-	typedef CyclicHash<uint64_t> HashFunction;
-	typedef std::unique_ptr<HashFunction> HashFunctionPtr;
-
+	//Parameters of the canonical rolling hash in the spirit of ntHash. A character is
+	//mapped to a 64-bit seed and the hash of a string is the XOR of the seeds of its
+	//characters rotated by their distances to the end of the string. Moving the window
+	//or extending it by a character costs a couple of rotations. An edge has at most
+	//64 characters up to k = 63 and their rotations are distinct. For longer vertices
+	//the rotation turns the upper 33 and the lower 31 bits separately as in ntHash, so
+	//its period is 1023 rather than 64 and the characters at a distance of 64 don't
+	//cancel out. Additional hash functions are derived from this base value with a
+	//multiply and a shift.
 	class VertexRollingHashSeed
 	{
 	public:
-		VertexRollingHashSeed(const VertexRollingHashSeed & s)
+		//Changes whenever the values of the functions do, the filters saved by the
+		//stage cache and the extendable graphs depend on them
+		static const uint64_t VERSION = 3;
+
+		VertexRollingHashSeed(size_t numberOfFunctions, size_t vertexLength, size_t bits) :
+			numberOfFunctions_(numberOfFunctions), vertexLength_(vertexLength), bits_(bits), split_(vertexLength >= 64)
 		{
-			hashFunction_.resize(s.HashFunctionsNumber());
-			for (HashFunctionPtr & ptr : hashFunction_)
+			mask_ = bits >= 64 ? UINT64_MAX : (uint64_t(1) << bits) - 1;
+			std::fill(seed_, seed_ + CHAR_SIZE, uint64_t(0));
+			seed_['A'] = 0x3C8BFBB395C60474ULL;
+			seed_['C'] = 0x3193C18562A02B4CULL;
+			seed_['G'] = 0x20323ED082572324ULL;
+			seed_['T'] = 0x295549F54BE24456ULL;
+			for (size_t ch = 0; ch < CHAR_SIZE; ch++)
 			{
-				ptr = HashFunctionPtr(new HashFunction(s.VertexLength(), s.BitsNumber()));
+				reverseSeed_[ch] = ch < CHAR_SIZE / 2 ? seed_[uint8_t(DnaChar::ReverseChar(char(ch)))] : 0;
 			}
 		}
 
-		VertexRollingHashSeed(size_t numberOfFunctions, size_t vertexLength, size_t bits)
+		size_t VertexLength() const
+		{
+			return vertexLength_;
+		}
+
+		size_t BitsNumber() const
+		{
+			return bits_;
+		}
+
+		size_t HashFunctionsNumber() const
+		{
+			return numberOfFunctions_;
+		}
+
+		uint64_t Rol(uint64_t value, size_t shift) const
 		{
-			hashFunction_.resize(numberOfFunctions);
-			for (HashFunctionPtr & ptr : hashFunction_)
+			if (split_)
 			{
-				ptr = HashFunctionPtr(new HashFunction(vertexLength, bits));
+				return SplitRol(value, shift % HIGH_BITS, shift % LOW_BITS);
 			}
+
+			shift &= 63;
+			return shift == 0 ? value : (value << shift) | (value >> (64 - shift));
 		}
 
-		size_t VertexLength() const
+		uint64_t Ror(uint64_t value, size_t shift) const
 		{
-			return hashFunction_[0]->n;
+			if (split_)
+			{
+				return SplitRol(value, HIGH_BITS - shift % HIGH_BITS, LOW_BITS - shift % LOW_BITS);
+			}
+
+			return Rol(value, 64 - (shift & 63));
 		}
 
-		size_t BitsNumber() const
+		uint64_t Seed(char ch) const
 		{
-			return hashFunction_[0]->wordsize;
+			return seed_[uint8_t(ch)];
 		}
 
-		size_t HashFunctionsNumber() const
+		uint64_t ReverseSeed(char ch) const
+		{
+			return reverseSeed_[uint8_t(ch)];
+		}
+
+		//Base hash of the string and of its reverse complement
+		uint64_t PositiveBase(std::string::const_iterator begin, size_t length) const
+		{
+			uint64_t ret = 0;
+			for (size_t i = 0; i < length; i++)
+			{
+				ret ^= Rol(Seed(begin[i]), length - i - 1);
+			}
+
+			return ret;
+		}
+
+		uint64_t NegativeBase(std::string::const_iterator begin, size_t length) const
 		{
-			return hashFunction_.size();
+			uint64_t ret = 0;
+			for (size_t i = 0; i < length; i++)
+			{
+				ret ^= Rol(ReverseSeed(begin[i]), i);
+			}
+
+			return ret;
+		}
+
+		//The value of the function idx for the string of the given length with the base hash
+		uint64_t Derive(uint64_t base, size_t length, size_t idx) const
+		{
+			if (idx > 0)
+			{
+				base *= Multiplier(length, idx);
+				base ^= base >> MULTI_SHIFT;
+			}
+
+			return base & mask_;
+		}
+
+		//The first count functions at once. The iterations are independent, so with a
+		//constant count the loop is unrolled and vectorised where it is inlined
+		void DeriveAll(uint64_t base, size_t length, uint64_t * value, size_t count) const
+		{
+			for (size_t idx = 0; idx < count; idx++)
+			{
+				uint64_t now = base * (idx == 0 ? 1 : Multiplier(length, idx));
+				value[idx] = (idx == 0 ? now : now ^ (now >> MULTI_SHIFT)) & mask_;
+			}
 		}
 
-	private:		
-		std::vector<HashFunctionPtr> hashFunction_;
-		friend class VertexRollingHash;
+	private:
+		static const size_t HIGH_BITS = 33;
+		static const size_t LOW_BITS = 31;
+		static const uint64_t LOW_MASK = (uint64_t(1) << LOW_BITS) - 1;
+		static const uint64_t HIGH_MASK = (uint64_t(1) << HIGH_BITS) - 1;
+
+		//Rotates the upper and the lower parts by the shifts below their widths
+		static uint64_t SplitRol(uint64_t value, size_t highShift, size_t lowShift)
+		{
+			uint64_t high = value >> LOW_BITS;
+			uint64_t low = value & LOW_MASK;
+			high = ((high << highShift) | (high >> (HIGH_BITS - highShift))) & HIGH_MASK;
+			low = ((low << lowShift) | (low >> (LOW_BITS - lowShift))) & LOW_MASK;
+			return (high << LOW_BITS) | low;
+		}
+
+		//An even multiplier loses the top bits of the base, so the multiplier is made
+		//odd. MULTI_SEED is even and 2 * idx + 1 keeps the functions distinct, unlike
+		//setting the low bit that would merge the functions 2i and 2i + 1
+		static uint64_t Multiplier(size_t length, size_t idx)
+		{
+			return (2 * idx + 1) ^ (length * MULTI_SEED);
+		}
+
+		static const size_t CHAR_SIZE = 1 << 8;
+		static const size_t MULTI_SHIFT = 27;
+		static const uint64_t MULTI_SEED = 0x90B45D39FB6DA1FAULL;
+		size_t numberOfFunctions_;
+		size_t vertexLength_;
+		size_t bits_;
+		bool split_;
+		uint64_t mask_;
+		uint64_t seed_[CHAR_SIZE];
+		uint64_t reverseSeed_[CHAR_SIZE];
 	};
 
+	//Hash of a sliding vertex and of its reverse complement. It only keeps the two
+	//base values, so it is cheap to create one per task.
 	class VertexRollingHash
 	{
 	public:
@@ -67,133 +185,137 @@ namespace TwoPaCo
 
 		size_t VertexLength() const
 		{
-			return posVertexHash_[0]->n;
+			return seed_.VertexLength();
 		}
 
 		size_t BitsNumber() const
 		{
-			return posVertexHash_[0]->wordsize;
+			return seed_.BitsNumber();
 		}
 
 		size_t HashFunctionsNumber() const
 		{
-			return posVertexHash_.size();
+			return hashFunctions_;
 		}
 
-		VertexRollingHash(const VertexRollingHashSeed & seed, std::string::const_iterator begin, size_t hashFunctions)
+		VertexRollingHash(const VertexRollingHashSeed & seed, std::string::const_iterator begin, size_t hashFunctions) : seed_(seed), hashFunctions_(hashFunctions)
 		{
-			size_t size = seed.hashFunction_[0]->n;
-			posVertexHash_.resize(hashFunctions);
-			negVertexHash_.resize(hashFunctions);
-			for (size_t i = 0; i < posVertexHash_.size(); i++)
-			{
-				posVertexHash_[i] = HashFunctionPtr(new HashFunction(*seed.hashFunction_[i]));
-				negVertexHash_[i] = HashFunctionPtr(new HashFunction(*seed.hashFunction_[i]));
-				for (auto it = begin; it != begin + size; ++it)
-				{
-					posVertexHash_[i]->eat(*it);
-				}
-
-				assert(posVertexHash_[i]->hashvalue == posVertexHash_[i]->hash(std::string(begin, begin + size)));
-				for (std::string::const_reverse_iterator it(begin + size); it != std::string::const_reverse_iterator(begin); ++it)
-				{
-					char ch = DnaChar::ReverseChar(*it);
-					negVertexHash_[i]->eat(DnaChar::ReverseChar(*it));
-				}
-
-				assert(negVertexHash_[i]->hashvalue == negVertexHash_[i]->hash(DnaChar::ReverseCompliment(std::string(begin, begin + size))));
-			}
+			posHash_ = seed_.PositiveBase(begin, seed_.VertexLength());
+			negHash_ = seed_.NegativeBase(begin, seed_.VertexLength());
 		}
 
 		void Update(char positivePreviousChar, char positiveNextChar)
 		{
-			char negativeNextChar = DnaChar::ReverseChar(positiveNextChar);
-			char negativePreviousChar = DnaChar::ReverseChar(positivePreviousChar);
-			for (size_t i = 0; i < posVertexHash_.size(); i++)
-			{
-				posVertexHash_[i]->update(positivePreviousChar, positiveNextChar);
-				negVertexHash_[i]->reverse_update(negativeNextChar, negativePreviousChar);
-			}
+			size_t length = seed_.VertexLength();
+			posHash_ = seed_.Rol(posHash_, 1) ^ seed_.Rol(seed_.Seed(positivePreviousChar), length) ^ seed_.Seed(positiveNextChar);
+			negHash_ = seed_.Ror(negHash_, 1) ^ seed_.Ror(seed_.ReverseSeed(positivePreviousChar), 1) ^
+				seed_.Rol(seed_.ReverseSeed(positiveNextChar), length - 1);
 		}
 
 		bool Assert(std::string::const_iterator begin) const
 		{
-			size_t size = posVertexHash_[0]->n;
-			for (size_t i = 0; i < posVertexHash_.size(); i++)
-			{
-				assert(posVertexHash_[i]->hashvalue == posVertexHash_[i]->hash(std::string(begin, begin + size)));
-				assert(negVertexHash_[i]->hashvalue == negVertexHash_[i]->hash(DnaChar::ReverseCompliment(std::string(begin, begin + size))));
-			}
-
+			assert(posHash_ == seed_.PositiveBase(begin, seed_.VertexLength()));
+			assert(negHash_ == seed_.NegativeBase(begin, seed_.VertexLength()));
 			return true;
 		}
 
 		uint64_t RawPositiveHash(size_t hf) const
 		{
-			return posVertexHash_[hf]->hashvalue;
+			return seed_.Derive(posHash_, seed_.VertexLength(), hf);
 		}
 
 		uint64_t RawNegativeHash(size_t hf) const
 		{
-			return negVertexHash_[hf]->hashvalue;
+			return seed_.Derive(negHash_, seed_.VertexLength(), hf);
+		}
+
+		void PositiveHashes(uint64_t * value, size_t count) const
+		{
+			seed_.DeriveAll(posHash_, seed_.VertexLength(), value, count);
+		}
+
+		void NegativeHashes(uint64_t * value, size_t count) const
+		{
+			seed_.DeriveAll(negHash_, seed_.VertexLength(), value, count);
 		}
 
 		uint64_t GetVertexHash() const
 		{			
-			uint64_t posHash = posVertexHash_[0]->hashvalue;
-			uint64_t negHash = negVertexHash_[0]->hashvalue;
-			return min(posHash, negHash);
+			return min(RawPositiveHash(0), RawNegativeHash(0));
 		}
 
 		uint64_t GetIngoingEdgeHash(char previousPositiveCharacter, StrandComparisonResult result, size_t idx) const
 		{
-			char previousNegativeCharacter = DnaChar::ReverseChar(previousPositiveCharacter);
-			if (result == positiveLess || result == tie)
-			{
-				return posVertexHash_[idx]->hash_prepend(previousPositiveCharacter);				
-			}
-			else
-			{
-				return negVertexHash_[idx]->hash_extend(previousNegativeCharacter);
-			}
+			return seed_.Derive(IngoingEdgeBase(previousPositiveCharacter, result), seed_.VertexLength() + 1, idx);
 		}
 		
 		uint64_t GetOutgoingEdgeHash(char nextPositiveCharacter, StrandComparisonResult result, size_t idx) const
 		{
-			char nextNegativeCharacter = DnaChar::ReverseChar(nextPositiveCharacter);
-			if (result == positiveLess || result == tie)
-			{
-				return posVertexHash_[idx]->hash_extend(nextPositiveCharacter);
-			}
-			else
-			{
-				return negVertexHash_[idx]->hash_prepend(nextNegativeCharacter);
-			}
+			return seed_.Derive(OutgoingEdgeBase(nextPositiveCharacter, result), seed_.VertexLength() + 1, idx);
 		}
 
-		StrandComparisonResult DetermineStrandExtend(char nextCh) const
+		//All functions of the edge, value must have room for HashFunctionsNumber() of them
+		void GetIngoingEdgeHashes(char previousPositiveCharacter, StrandComparisonResult result, uint64_t * value) const
 		{
-			char revNextCh = DnaChar::ReverseChar(nextCh);
-			for (size_t i = 0; i < posVertexHash_.size(); i++)
-			{
-				uint64_t posHash = posVertexHash_[i]->hash_extend(nextCh);
-				uint64_t negHash = negVertexHash_[i]->hash_prepend(revNextCh);
-				if (posHash != negHash)
-				{
-					return posHash < negHash ? positiveLess : negativeLess;
-				}
-			}
+			seed_.DeriveAll(IngoingEdgeBase(previousPositiveCharacter, result), seed_.VertexLength() + 1, value, hashFunctions_);
+		}
 
-			return tie;
+		void GetOutgoingEdgeHashes(char nextPositiveCharacter, StrandComparisonResult result, uint64_t * value) const
+		{
+			seed_.DeriveAll(OutgoingEdgeBase(nextPositiveCharacter, result), seed_.VertexLength() + 1, value, hashFunctions_);
+		}
+
+		StrandComparisonResult DetermineStrandExtend(char nextCh) const
+		{
+			return CompareStrands(PositiveExtend(nextCh), NegativePrepend(nextCh));
 		}
 
 		StrandComparisonResult DetermineStrandPrepend(char prevCh) const
 		{
-			char revPrevCh = DnaChar::ReverseChar(prevCh);
-			for (size_t i = 0; i < posVertexHash_.size(); i++)
+			return CompareStrands(PositivePrepend(prevCh), NegativeExtend(prevCh));
+		}
+
+	private:
+		//Base hash of the edge in the orientation chosen by the strand comparison
+		uint64_t IngoingEdgeBase(char ch, StrandComparisonResult result) const
+		{
+			return result == positiveLess || result == tie ? PositivePrepend(ch) : NegativeExtend(ch);
+		}
+
+		uint64_t OutgoingEdgeBase(char ch, StrandComparisonResult result) const
+		{
+			return result == positiveLess || result == tie ? PositiveExtend(ch) : NegativePrepend(ch);
+		}
+
+		//Base hashes of the edges obtained by adding a character of the positive strand
+		//to the end or to the beginning of the vertex
+		uint64_t PositiveExtend(char ch) const
+		{
+			return seed_.Rol(posHash_, 1) ^ seed_.Seed(ch);
+		}
+
+		uint64_t PositivePrepend(char ch) const
+		{
+			return seed_.Rol(seed_.Seed(ch), seed_.VertexLength()) ^ posHash_;
+		}
+
+		uint64_t NegativePrepend(char ch) const
+		{
+			return seed_.Rol(seed_.ReverseSeed(ch), seed_.VertexLength()) ^ negHash_;
+		}
+
+		uint64_t NegativeExtend(char ch) const
+		{
+			return seed_.Rol(negHash_, 1) ^ seed_.ReverseSeed(ch);
+		}
+
+		StrandComparisonResult CompareStrands(uint64_t posBase, uint64_t negBase) const
+		{
+			size_t length = seed_.VertexLength() + 1;
+			for (size_t i = 0; i < hashFunctions_; i++)
 			{
-				uint64_t posHash = posVertexHash_[i]->hash_prepend(prevCh);
-				uint64_t negHash = negVertexHash_[i]->hash_extend(revPrevCh);
+				uint64_t posHash = seed_.Derive(posBase, length, i);
+				uint64_t negHash = seed_.Derive(negBase, length, i);
 				if (posHash != negHash)
 				{
 					return posHash < negHash ? positiveLess : negativeLess;
@@ -203,10 +325,11 @@ namespace TwoPaCo
 			return tie;
 		}
 
-	private:
-		DISALLOW_COPY_AND_ASSIGN(VertexRollingHash);		
-		std::vector<HashFunctionPtr> posVertexHash_;
-		std::vector<HashFunctionPtr> negVertexHash_;			
+		DISALLOW_COPY_AND_ASSIGN(VertexRollingHash);
+		const VertexRollingHashSeed & seed_;
+		size_t hashFunctions_;
+		uint64_t posHash_;
+		uint64_t negHash_;
 	};
 
 	inline bool IsOutgoingEdgeInBloomFilter(const VertexRollingHash & hash, const CuckooFilter<size_t, 32> & cFilter, char nextCh)
@@ -267,20 +390,16 @@ namespace TwoPaCo
 
 	inline void GetOutgoingEdgeHash(const VertexRollingHash & hash, char nextCh, std::vector<uint64_t> & value)
 	{
-		VertexRollingHash::StrandComparisonResult result = hash.DetermineStrandExtend(nextCh);
-		for (size_t i = 0; i < hash.HashFunctionsNumber(); i++)
-		{
-			value.push_back(hash.GetOutgoingEdgeHash(nextCh, result, i));
-		}
+		size_t size = value.size();
+		value.resize(size + hash.HashFunctionsNumber());
+		hash.GetOutgoingEdgeHashes(nextCh, hash.DetermineStrandExtend(nextCh), value.data() + size);
 	}
 
 	inline void GetIngoingEdgeHash(const VertexRollingHash & hash, char prevCh, std::vector<uint64_t> & value)
 	{
-		VertexRollingHash::StrandComparisonResult result = hash.DetermineStrandPrepend(prevCh);
-		for (size_t i = 0; i < hash.HashFunctionsNumber(); i++)
-		{
-			value.push_back(hash.GetIngoingEdgeHash(prevCh, result, i));
-		}
+		size_t size = value.size();
+		value.resize(size + hash.HashFunctionsNumber());
+		hash.GetIngoingEdgeHashes(prevCh, hash.DetermineStrandPrepend(prevCh), value.data() + size);
 	}
 }
 
@@ -0,0 +1,224 @@
+#ifndef _EXTERNAL_SORT_H_
+#define _EXTERNAL_SORT_H_
+
+#include <queue>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include <tbb/parallel_sort.h>
+
+namespace TwoPaCo
+{
+	//Sorts a stream of trivially copyable records using a bounded amount of memory.
+	//Records are accumulated into runs that are sorted in parallel and spilled to
+	//temporary files, then the runs are merged back with a k-way merge. If the
+	//whole input fits into a single run, no temporary files are created. The names
+	//of the temporary files include the process id, so several processes can share
+	//the temporary directory.
+	template<class T, class Compare>
+	class ExternalSorter
+	{
+	public:
+		ExternalSorter(const std::string & tmpFilePrefix, size_t memoryLimit, Compare comp) :
+			tmpFilePrefix_(tmpFilePrefix), comp_(comp), sorted_(false), bufferPos_(0)
+		{
+			runSize_ = std::max(size_t(1), memoryLimit / sizeof(T));
+		}
+
+		~ExternalSorter()
+		{
+			run_.clear();
+			for (size_t i = 0; i < runCount_.size(); i++)
+			{
+				std::remove(RunFileName(i).c_str());
+			}
+		}
+
+		void Push(const T & item)
+		{
+			if (sorted_)
+			{
+				throw std::runtime_error("Can't add a record to an already sorted stream");
+			}
+
+			//The run takes exactly the memory limit, the growth of the vector could
+			//double it. The capacity is kept by clear() across the runs
+			if (buffer_.capacity() == 0)
+			{
+				buffer_.reserve(runSize_);
+			}
+
+			buffer_.push_back(item);
+			if (buffer_.size() >= runSize_)
+			{
+				FlushRun();
+			}
+		}
+
+		void Sort()
+		{
+			sorted_ = true;
+			if (runCount_.empty())
+			{
+				tbb::parallel_sort(buffer_.begin(), buffer_.end(), comp_);
+				return;
+			}
+
+			if (buffer_.size() > 0)
+			{
+				FlushRun();
+			}
+
+			std::vector<T>().swap(buffer_);
+			size_t blockSize = std::max(size_t(1), std::min(runSize_ / runCount_.size(), BLOCK_SIZE / sizeof(T)));
+			for (size_t i = 0; i < runCount_.size(); i++)
+			{
+				run_.push_back(RunPtr(new Run(RunFileName(i), runCount_[i], blockSize)));
+				T item;
+				if (run_.back()->Next(item))
+				{
+					head_.push(HeadItem(item, i, comp_));
+				}
+			}
+		}
+
+		bool Next(T & item)
+		{
+			if (run_.empty())
+			{
+				if (bufferPos_ < buffer_.size())
+				{
+					item = buffer_[bufferPos_++];
+					return true;
+				}
+
+				return false;
+			}
+
+			if (head_.empty())
+			{
+				return false;
+			}
+
+			HeadItem top = head_.top();
+			head_.pop();
+			item = top.item;
+			T next;
+			if (run_[top.run]->Next(next))
+			{
+				head_.push(HeadItem(next, top.run, comp_));
+			}
+
+			return true;
+		}
+
+	private:
+		static const size_t BLOCK_SIZE = 1 << 20;
+
+		class Run
+		{
+		public:
+			Run(const std::string & fileName, size_t count, size_t blockSize) : remain_(count), pos_(0), blockSize_(blockSize), in_(fileName.c_str(), std::ios::binary)
+			{
+				if (!in_)
+				{
+					throw std::runtime_error("Can't open a temporary file");
+				}
+			}
+
+			bool Next(T & item)
+			{
+				if (pos_ == block_.size())
+				{
+					if (remain_ == 0)
+					{
+						return false;
+					}
+
+					size_t toRead = std::min(remain_, blockSize_);
+					block_.resize(toRead);
+					if (!in_.read(reinterpret_cast<char*>(&block_[0]), sizeof(T) * toRead))
+					{
+						throw std::runtime_error("Can't read from a temporary file");
+					}
+
+					remain_ -= toRead;
+					pos_ = 0;
+				}
+
+				item = block_[pos_++];
+				return true;
+			}
+
+		private:
+			size_t remain_;
+			size_t pos_;
+			size_t blockSize_;
+			std::ifstream in_;
+			std::vector<T> block_;
+		};
+
+		struct HeadItem
+		{
+			T item;
+			size_t run;
+			Compare comp;
+			HeadItem(const T & item, size_t run, Compare comp) : item(item), run(run), comp(comp) {}
+			bool operator < (const HeadItem & other) const
+			{
+				//std::priority_queue pops the largest element first, so invert the order
+				return comp(other.item, item);
+			}
+		};
+
+		typedef std::unique_ptr<Run> RunPtr;
+
+		std::string RunFileName(size_t run) const
+		{
+			std::stringstream ss;
+			ss << tmpFilePrefix_ << "_" << getpid() << "_" << run << ".tmp";
+			return ss.str();
+		}
+
+		void FlushRun()
+		{
+			tbb::parallel_sort(buffer_.begin(), buffer_.end(), comp_);
+			std::string fileName = RunFileName(runCount_.size());
+			std::ofstream out(fileName.c_str(), std::ios::binary);
+			if (!out)
+			{
+				throw std::runtime_error("Can't create a temporary file");
+			}
+
+			runCount_.push_back(buffer_.size());
+			if (!out.write(reinterpret_cast<const char*>(&buffer_[0]), sizeof(T) * buffer_.size()))
+			{
+				throw std::runtime_error("Can't write to a temporary file");
+			}
+
+			buffer_.clear();
+		}
+
+		std::string tmpFilePrefix_;
+		Compare comp_;
+		bool sorted_;
+		size_t runSize_;
+		size_t bufferPos_;
+		std::vector<T> buffer_;
+		std::vector<RunPtr> run_;
+		std::vector<size_t> runCount_;
+		std::priority_queue<HeadItem> head_;
+		ExternalSorter(const ExternalSorter &);
+		void operator = (const ExternalSorter &);
+	};
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include <map>
+#include <atomic>
 #include <deque>
+#include <cstring>
+#include <numeric>
 #include <string>
 #include <vector>
 #include <bitset>
@@ -9,31 +12,29 @@
 #include <iterator>
 #include <iostream>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <tclap/CmdLine.h>
+#include <tbb/task_group.h>
 #include <tbb/parallel_sort.h>
 
 #include <dnachar.h>
 #include <streamfastaparser.h>
 #include <junctionapi/junctionapi.h>
+#include <junctionapi/compactpath.h>
+#include <junctionapi/compactedgraph.h>
+#include <junctionapi/sequencemanifest.h>
 
+#include "externalsort.h"
+#include "junctionindex.h"
 
-bool CompareJunctionsById(const TwoPaCo::JunctionPosition & a, const TwoPaCo::JunctionPosition & b)
-{
-	return a.GetId() < b.GetId();
-}
 
 bool CompareJunctionsByPos(const TwoPaCo::JunctionPosition & a, const TwoPaCo::JunctionPosition & b)
 {
 	return std::make_pair(a.GetChr(), a.GetPos()) < std::make_pair(b.GetChr(), b.GetPos());
 }
 
-struct EqClass
-{
-	int64_t label;
-	std::vector<TwoPaCo::JunctionPosition> position;
-};
-
 int64_t Abs(int64_t x)
 {
 	return x > 0 ? x : -x;
@@ -112,49 +113,81 @@ private:
 	TwoPaCo::JunctionPosition end_;	
 };
 
-bool CompareJunctionClasses(const EqClass & a, const EqClass & b)
+bool CompareJunctionsById(const TwoPaCo::JunctionPosition & a, const TwoPaCo::JunctionPosition & b)
 {
-	return CompareJunctionsByPos(a.position[0], b.position[0]);
+	if (a.GetId() != b.GetId())
+	{
+		return a.GetId() < b.GetId();
+	}
+
+	return CompareJunctionsByPos(a, b);
 }
 
-void GenerateGroupOutupt(const std::string & inputFileName)
+struct ClassMember
 {
-	TwoPaCo::JunctionPosition pos;
-	TwoPaCo::JunctionPositionReader reader(inputFileName.c_str());
-	std::vector<EqClass> eqClass;
-	std::vector<TwoPaCo::JunctionPosition> junction;
-	while (reader.NextJunctionPosition(pos))
-	{
-		junction.push_back(pos);
-	}
-	 
-	std::sort(junction.begin(), junction.end(), CompareJunctionsById);
-	for (size_t i = 0; i < junction.size();)
+	uint32_t classChr;
+	uint32_t classPos;
+	uint32_t chr;
+	uint32_t pos;
+};
+
+bool CompareClassMembers(const ClassMember & a, const ClassMember & b)
+{
+	return std::make_pair(std::make_pair(a.classChr, a.classPos), std::make_pair(a.chr, a.pos)) <
+		std::make_pair(std::make_pair(b.classChr, b.classPos), std::make_pair(b.chr, b.pos));
+}
+
+void GenerateGroupOutupt(const std::string & inputFileName, const std::string & tmpDirName, uint64_t memoryLimit)
+{
+	//The first pass groups junctions into equivalence classes by sorting them by ID. Each member is
+	//then labeled with the first position of its class, and the second pass orders classes by it.
+	//Both sorters hold their runs at the same time, so each of them gets half of the memory.
+	typedef bool(*JunctionCompare)(const TwoPaCo::JunctionPosition &, const TwoPaCo::JunctionPosition &);
+	typedef bool(*MemberCompare)(const ClassMember &, const ClassMember &);
+	TwoPaCo::ExternalSorter<ClassMember, MemberCompare> memberSorter(tmpDirName + "/group_pos", memoryLimit / 2, CompareClassMembers);
 	{
-		size_t j = i;
-		for (; j < junction.size() && junction[i].GetId() == junction[j].GetId(); j++);
-		std::sort(junction.begin() + i, junction.begin() + j, CompareJunctionsByPos);
-		eqClass.push_back(EqClass());
-		eqClass.back().label = junction[i].GetId();
-		for (size_t k = i; k < j; k++)
+		TwoPaCo::JunctionPosition pos;
+		TwoPaCo::JunctionPositionReader reader(inputFileName.c_str());
+		TwoPaCo::ExternalSorter<TwoPaCo::JunctionPosition, JunctionCompare> junctionSorter(tmpDirName + "/group_id", memoryLimit / 2, CompareJunctionsById);
+		while (reader.NextJunctionPosition(pos))
 		{
-			eqClass.back().position.push_back(junction[k]);
+			junctionSorter.Push(pos);
 		}
 
-		i = j;
+		junctionSorter.Sort();
+		TwoPaCo::JunctionPosition first;
+		while (junctionSorter.Next(pos))
+		{
+			if (pos.GetId() != first.GetId())
+			{
+				first = pos;
+			}
+
+			ClassMember member = { first.GetChr(), first.GetPos(), pos.GetChr(), pos.GetPos() };
+			memberSorter.Push(member);
+		}
 	}
 
-	tbb::parallel_sort(eqClass.begin(), eqClass.end(), CompareJunctionClasses);
-	for (auto junctionClass : eqClass)
+	memberSorter.Sort();
+	ClassMember member;
+	bool open = false;
+	std::pair<uint32_t, uint32_t> currentClass;
+	while (memberSorter.Next(member))
 	{
-		for (auto j : junctionClass.position)
+		if (open && currentClass != std::make_pair(member.classChr, member.classPos))
 		{
-			std::cout << j.GetChr() << ' ' << j.GetPos() << "; ";
+			std::cout << std::endl;
 		}
 
-		std::cout << std::endl;
+		open = true;
+		currentClass = std::make_pair(member.classChr, member.classPos);
+		std::cout << member.chr << ' ' << member.pos << "; ";
 	}
 
+	if (open)
+	{
+		std::cout << std::endl;
+	}
 }
 
 void GenerateOrdinaryOutput(const std::string & inputFileName)
@@ -172,37 +205,138 @@ char Sign(int64_t arg)
 	return arg >= 0 ? '+' : '-';
 }
 
-void ReadInputSequences(const std::vector<std::string> & genomes, std::vector<std::string> & chrSegmentId, std::vector<uint64_t> & chrSegmentLength, std::map<std::string, std::string> & fileName, bool noPrefix)
+void Multiplicity(uint64_t multiplicity, std::ostream & out)
+{
+	if (multiplicity > 0)
+	{
+		out << "\tRC:i:" << multiplicity;
+	}
+
+	out << std::endl;
+}
+
+struct LinkKey
+{
+	int64_t from;
+	int64_t to;
+
+	bool operator == (const LinkKey & other) const
+	{
+		return from == other.from && to == other.to;
+	}
+};
+
+class LinkKeyHash
+{
+public:
+	size_t operator()(const LinkKey & key) const
+	{
+		uint64_t hash = uint64_t(key.from) * 0x9E3779B97F4A7C15ULL;
+		return hash ^ (hash >> 29) ^ uint64_t(key.to);
+	}
+};
+
+//Set of distinct links of a bidirected graph with their multiplicities. A link
+//from a to b is the same as the one from -b to -a. The payload of the first
+//occurrence of each link is kept, links are enumerated in the order of appearance.
+template<class T>
+class LinkSet
+{
+public:
+	bool Add(int64_t from, int64_t to, const T & payload)
+	{
+		LinkKey key = { from, to };
+		LinkKey reverse = { -to, -from };
+		if (std::make_pair(reverse.from, reverse.to) < std::make_pair(key.from, key.to))
+		{
+			key = reverse;
+		}
+
+		auto ret = index_.insert(std::make_pair(key, link_.size()));
+		if (ret.second)
+		{
+			link_.push_back(std::make_pair(payload, uint64_t(1)));
+		}
+		else
+		{
+			++link_[ret.first->second].second;
+		}
+
+		return ret.second;
+	}
+
+	size_t Size() const
+	{
+		return link_.size();
+	}
+
+	const T & Payload(size_t idx) const
+	{
+		return link_[idx].first;
+	}
+
+	uint64_t Multiplicity(size_t idx) const
+	{
+		return link_[idx].second;
+	}
+
+private:
+	std::vector<std::pair<T, uint64_t> > link_;
+	std::unordered_map<LinkKey, size_t, LinkKeyHash> index_;
+};
+
+enum LinkMode
+{
+	ALL_LINKS,
+	UNIQUE_LINKS,
+	COUNTED_LINKS
+};
+
+void ReadInputSequences(const std::string & inputFileName, const std::vector<std::string> & genomes, TwoPaCo::SequenceManifest & manifest, std::vector<std::string> & chrSegmentId, std::vector<uint64_t> & chrSegmentLength, std::map<std::string, std::string> & fileName, bool noPrefix)
 {
 	size_t chrCount = 0;
 	chrSegmentId.clear();	
 	chrSegmentLength.clear();
-	for (const std::string & chrFileName : genomes)
+	if (!manifest.ReadFromFile(TwoPaCo::SequenceManifest::DefaultFileName(inputFileName)) || !manifest.Matches(genomes))
 	{
-		TwoPaCo::StreamFastaParser parser(chrFileName);
-		while (parser.ReadRecord())
+		//No manifest from twopaco, have to parse the input to get names and lengths of the records
+		manifest = TwoPaCo::SequenceManifest();
+		for (const std::string & chrFileName : genomes)
 		{
-			std::stringstream ssId;
-			if (noPrefix)
-			{
-				ssId << parser.GetCurrentHeader();
-			}
-			else
+			TwoPaCo::StreamFastaParser parser(chrFileName);
+			while (parser.ReadRecord())
 			{
-				ssId << "s" << chrCount << "_" << parser.GetCurrentHeader();
+				uint64_t size = 0;
+				for (char ch; parser.GetChar(ch); ++size);
+				manifest.Add(TwoPaCo::SequenceRecord(chrFileName, parser.GetCurrentHeader(), size, parser.GetCurrentOffset(), parser.GetLineWidth(), parser.GetLineBytes()));
 			}
+		}
+	}
 
-			chrSegmentId.push_back(ssId.str());
-			fileName[ssId.str()] = chrFileName;
-		
-
-			uint64_t size = 0;
-			for (char ch; parser.GetChar(ch); ++size);
-			chrSegmentLength.push_back(size);
+	for (size_t i = 0; i < manifest.Size(); i++)
+	{
+		std::stringstream ssId;
+		if (noPrefix)
+		{
+			ssId << manifest[i].header;
+		}
+		else
+		{
+			ssId << "s" << chrCount << "_" << manifest[i].header;
 		}
+
+		chrSegmentId.push_back(ssId.str());
+		fileName[ssId.str()] = manifest[i].fileName;
+		chrSegmentLength.push_back(manifest[i].length);
 	}
 }
 
+void ReadInputSequences(const std::string & inputFileName, const std::vector<std::string> & genomes, std::vector<std::string> & chrSegmentId, std::vector<uint64_t> & chrSegmentLength, std::map<std::string, std::string> & fileName, bool noPrefix)
+{
+	TwoPaCo::SequenceManifest manifest;
+	ReadInputSequences(inputFileName, genomes, manifest, chrSegmentId, chrSegmentLength, fileName, noPrefix);
+}
+
 class Gfa1Generator
 {
 public:
@@ -239,14 +373,15 @@ public:
 			<< end << std::endl;
 	}
 
-	void Edge(int64_t prevSegmentId, uint64_t prevSegmentSize, int64_t segmentId, uint64_t segmentSize, uint64_t k, std::ostream & out) const
+	void Edge(int64_t prevSegmentId, uint64_t prevSegmentSize, int64_t segmentId, uint64_t segmentSize, uint64_t k, uint64_t multiplicity, std::ostream & out) const
 	{
 		out << "L\t" 
 			<< Abs(prevSegmentId) << '\t' 
 			<< Sign(prevSegmentId) << '\t' 
 			<< Abs(segmentId) << '\t' 
 			<< Sign(segmentId) << '\t' 
-			<< k << 'M' << std::endl;
+			<< k << 'M';
+		Multiplicity(multiplicity, out);
 	}
 
 	void FlushPath(std::vector<int64_t> & currentPath, const std::string & seqId, size_t k, std::ostream & out) const
@@ -263,6 +398,11 @@ public:
 			currentPath.clear();
 		}
 	}
+
+	void Footer(std::ostream & out) const
+	{
+
+	}
 };
 
 std::string Gfa2Position(size_t pos, size_t length)
@@ -320,7 +460,7 @@ public:
 			<< k << "M" << std::endl;
 	}
 
-	void Edge(int64_t prevSegmentId, uint64_t prevSegmentSize, int64_t segmentId, uint64_t segmentSize, uint64_t k, std::ostream & out) const
+	void Edge(int64_t prevSegmentId, uint64_t prevSegmentSize, int64_t segmentId, uint64_t segmentSize, uint64_t k, uint64_t multiplicity, std::ostream & out) const
 	{
 		uint64_t prevSegmentStart;
 		uint64_t prevSegmentEnd;
@@ -355,7 +495,8 @@ public:
 			<< Gfa2Position(prevSegmentEnd, prevSegmentSize) << '\t'
 			<< Gfa2Position(segmentStart, segmentSize) << '\t'
 			<< Gfa2Position(segmentEnd, segmentSize) << '\t'
-			<< k << 'M' << std::endl;
+			<< k << 'M';
+		Multiplicity(multiplicity, out);
 	}
 
 	void FlushPath(std::vector<int64_t> & currentPath, const std::string & seqId, size_t k, std::ostream & out) const
@@ -372,11 +513,391 @@ public:
 			currentPath.clear();
 		}
 	}
+
+	void Footer(std::ostream & out) const
+	{
+
+	}
+};
+
+struct OrientedLink
+{
+	uint64_t from;
+	uint64_t to;
+};
+
+bool CompareOrientedLinks(const OrientedLink & a, const OrientedLink & b)
+{
+	return std::make_pair(a.from, a.to) < std::make_pair(b.from, b.to);
+}
+
+//Writes the graph in the memory-mappable format described in compactedgraph.h.
+//Sequences, links and paths are spooled to temporary files while the junctions are
+//read, the sections are assembled at the end since the header has to go first.
+class BinaryGraphGenerator
+{
+public:
+	BinaryGraphGenerator(size_t k, const std::string & tmpDirName, uint64_t memoryLimit) : k_(k), basesCount_(0), nCount_(0), stepsCount_(0), packedByte_(0),
+		sequenceFileName_(tmpDirName + "/graph_sequence.tmp"), nPositionFileName_(tmpDirName + "/graph_n.tmp"), pathStepFileName_(tmpDirName + "/graph_path.tmp"),
+		linkSorter_(tmpDirName + "/graph_link", memoryLimit, CompareOrientedLinks)
+	{
+		segmentOffset_.push_back(0);
+		pathOffset_.push_back(0);
+		pathNameOffset_.push_back(0);
+		OpenTemporary(sequenceFileName_, sequence_);
+		OpenTemporary(nPositionFileName_, nPosition_);
+		OpenTemporary(pathStepFileName_, pathStep_);
+	}
+
+	~BinaryGraphGenerator()
+	{
+		std::remove(sequenceFileName_.c_str());
+		std::remove(nPositionFileName_.c_str());
+		std::remove(pathStepFileName_.c_str());
+	}
+
+	void Header(std::ostream & out)
+	{
+
+	}
+
+	void ListInputSequences(const std::vector<std::string> & seq, std::map<std::string, std::string> & fileName, std::ostream & out)
+	{
+
+	}
+
+	void Segment(int64_t segmentId, uint64_t segmentSize, const std::string & body, std::ostream & out)
+	{
+		denseId_[Abs(segmentId)] = segmentName_.size();
+		segmentName_.push_back(Abs(segmentId));
+		nMask_.resize((body.size() + 63) / 64);
+		TwoPaCo::DnaChar::NMask(body.data(), body.size(), nMask_.data());
+		for (size_t i = 0; i < nMask_.size(); i++)
+		{
+			for (uint64_t bits = nMask_[i]; bits != 0; bits &= bits - 1)
+			{
+				uint64_t position = basesCount_ + i * 64 + __builtin_ctzll(bits);
+				nPosition_.write(reinterpret_cast<const char*>(&position), sizeof(position));
+				++nCount_;
+			}
+		}
+
+		for (char ch : body)
+		{
+			packedByte_ |= TwoPaCo::DnaChar::Code(ch) << ((basesCount_ & 3) << 1);
+			if ((++basesCount_ & 3) == 0)
+			{
+				sequence_.put(packedByte_);
+				packedByte_ = 0;
+			}
+		}
+
+		segmentOffset_.push_back(basesCount_);
+	}
+
+	void Occurrence(int64_t segmentId, uint64_t segmentSize, const std::string & chrSegmentId, uint64_t chrSegmentSize, uint64_t begin, uint64_t end, uint64_t k, std::ostream & out)
+	{
+
+	}
+
+	void Edge(int64_t prevSegmentId, uint64_t prevSegmentSize, int64_t segmentId, uint64_t segmentSize, uint64_t k, uint64_t multiplicity, std::ostream & out)
+	{
+		uint64_t prev = Oriented(prevSegmentId);
+		uint64_t next = Oriented(segmentId);
+		OrientedLink link = { prev, next };
+		OrientedLink reverseLink = { TwoPaCo::CompactedGraph::Flip(next), TwoPaCo::CompactedGraph::Flip(prev) };
+		linkSorter_.Push(link);
+		linkSorter_.Push(reverseLink);
+	}
+
+	void FlushPath(std::vector<int64_t> & currentPath, const std::string & seqId, size_t k, std::ostream & out)
+	{
+		if (currentPath.size() > 0)
+		{
+			for (int64_t segmentId : currentPath)
+			{
+				uint64_t step = Oriented(segmentId);
+				pathStep_.write(reinterpret_cast<const char*>(&step), sizeof(step));
+			}
+
+			stepsCount_ += currentPath.size();
+			pathOffset_.push_back(stepsCount_);
+			pathName_ += seqId;
+			pathNameOffset_.push_back(pathName_.size());
+			currentPath.clear();
+		}
+	}
+
+	void Footer(std::ostream & out)
+	{
+		if ((basesCount_ & 3) != 0)
+		{
+			sequence_.put(packedByte_);
+		}
+
+		sequence_.close();
+		nPosition_.close();
+		pathStep_.close();
+		std::vector<uint64_t> linkOffset(segmentName_.size() * 2 + 1, 0);
+		std::string linkTargetFileName = pathStepFileName_ + ".link";
+		std::ofstream linkTarget;
+		OpenTemporary(linkTargetFileName, linkTarget);
+		uint64_t linksCount = 0;
+		linkSorter_.Sort();
+		for (OrientedLink link, prev = { UINT64_MAX, UINT64_MAX }; linkSorter_.Next(link); prev = link)
+		{
+			if (link.from != prev.from || link.to != prev.to)
+			{
+				++linkOffset[link.from + 1];
+				++linksCount;
+				linkTarget.write(reinterpret_cast<const char*>(&link.to), sizeof(link.to));
+			}
+		}
+
+		linkTarget.close();
+		std::partial_sum(linkOffset.begin(), linkOffset.end(), linkOffset.begin());
+
+		TwoPaCo::CompactedGraphHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TwoPaCo::CompactedGraphHeader::Magic(), sizeof(header.magic));
+		header.version = TwoPaCo::CompactedGraphHeader::VERSION;
+		header.k = k_;
+		header.segmentsCount = segmentName_.size();
+		header.basesCount = basesCount_;
+		header.nCount = nCount_;
+		header.linksCount = linksCount;
+		header.pathsCount = pathOffset_.size() - 1;
+		header.stepsCount = stepsCount_;
+		uint64_t sectionSize[] =
+		{
+			segmentOffset_.size() * sizeof(uint64_t),
+			segmentName_.size() * sizeof(int64_t),
+			(basesCount_ + 3) / 4,
+			nCount_ * sizeof(uint64_t),
+			linkOffset.size() * sizeof(uint64_t),
+			linksCount * sizeof(uint64_t),
+			pathOffset_.size() * sizeof(uint64_t),
+			stepsCount_ * sizeof(uint64_t),
+			pathNameOffset_.size() * sizeof(uint64_t),
+			pathName_.size()
+		};
+
+		uint64_t offset = TwoPaCo::CompactedGraphHeader::Align(sizeof(header));
+		for (size_t i = 0; i < TwoPaCo::CompactedGraphHeader::SECTIONS_COUNT; i++)
+		{
+			header.section[i].offset = offset;
+			header.section[i].size = sectionSize[i];
+			offset = TwoPaCo::CompactedGraphHeader::Align(offset + sectionSize[i]);
+		}
+
+		uint64_t written = 0;
+		WriteSection(out, reinterpret_cast<const char*>(&header), sizeof(header), written);
+		WriteSection(out, reinterpret_cast<const char*>(segmentOffset_.data()), sectionSize[0], written);
+		WriteSection(out, reinterpret_cast<const char*>(segmentName_.data()), sectionSize[1], written);
+		CopySection(out, sequenceFileName_, sectionSize[2], written);
+		CopySection(out, nPositionFileName_, sectionSize[3], written);
+		WriteSection(out, reinterpret_cast<const char*>(linkOffset.data()), sectionSize[4], written);
+		CopySection(out, linkTargetFileName, sectionSize[5], written);
+		WriteSection(out, reinterpret_cast<const char*>(pathOffset_.data()), sectionSize[6], written);
+		CopySection(out, pathStepFileName_, sectionSize[7], written);
+		WriteSection(out, reinterpret_cast<const char*>(pathNameOffset_.data()), sectionSize[8], written);
+		WriteSection(out, pathName_.data(), sectionSize[9], written);
+		std::remove(linkTargetFileName.c_str());
+		if (!out)
+		{
+			throw std::runtime_error("Can't write the graph");
+		}
+	}
+
+private:
+	static void OpenTemporary(const std::string & fileName, std::ofstream & out)
+	{
+		out.open(fileName.c_str(), std::ios::binary);
+		if (!out)
+		{
+			throw std::runtime_error("Can't create a temporary file");
+		}
+	}
+
+	static void Pad(std::ostream & out, uint64_t & written)
+	{
+		for (uint64_t aligned = TwoPaCo::CompactedGraphHeader::Align(written); written < aligned; ++written)
+		{
+			out.put(0);
+		}
+	}
+
+	static void WriteSection(std::ostream & out, const char * data, uint64_t size, uint64_t & written)
+	{
+		out.write(data, size);
+		written += size;
+		Pad(out, written);
+	}
+
+	static void CopySection(std::ostream & out, const std::string & fileName, uint64_t size, uint64_t & written)
+	{
+		std::ifstream in(fileName.c_str(), std::ios::binary);
+		std::vector<char> buf(1 << 20);
+		for (uint64_t remain = size; remain > 0;)
+		{
+			uint64_t now = std::min(remain, uint64_t(buf.size()));
+			if (!in.read(buf.data(), now))
+			{
+				throw std::runtime_error("Can't read from a temporary file");
+			}
+
+			out.write(buf.data(), now);
+			remain -= now;
+		}
+
+		written += size;
+		Pad(out, written);
+	}
+
+	uint64_t Oriented(int64_t segmentId) const
+	{
+		return TwoPaCo::CompactedGraph::Oriented(denseId_.find(Abs(segmentId))->second, segmentId > 0);
+	}
+
+	size_t k_;
+	uint64_t basesCount_;
+	uint64_t nCount_;
+	uint64_t stepsCount_;
+	char packedByte_;
+	std::string pathName_;
+	std::string sequenceFileName_;
+	std::string nPositionFileName_;
+	std::string pathStepFileName_;
+	std::ofstream sequence_;
+	std::ofstream nPosition_;
+	std::ofstream pathStep_;
+	std::vector<uint64_t> nMask_;
+	std::vector<int64_t> segmentName_;
+	std::vector<uint64_t> segmentOffset_;
+	std::vector<uint64_t> pathOffset_;
+	std::vector<uint64_t> pathNameOffset_;
+	std::unordered_map<int64_t, uint64_t> denseId_;
+	TwoPaCo::ExternalSorter<OrientedLink, bool(*)(const OrientedLink &, const OrientedLink &)> linkSorter_;
+};
+
+//Writes paths to a compact sidecar file, see compactpath.h. Paths are encoded by
+//parallel tasks and written in the order they were added.
+class CompactPathWriter
+{
+public:
+	CompactPathWriter(const std::string & fileName) : written_(0), out_(fileName.c_str(), std::ios::binary)
+	{
+		uint64_t version = TwoPaCo::CompactPath::VERSION;
+		out_.write(TwoPaCo::CompactPath::Magic(), 8);
+		out_.write(reinterpret_cast<const char*>(&version), sizeof(version));
+		written_ = 8 + sizeof(version);
+		if (!out_)
+		{
+			throw std::runtime_error("Can't create the path file");
+		}
+	}
+
+	~CompactPathWriter()
+	{
+		group_.wait();
+	}
+
+	void Add(std::vector<int64_t> & currentPath, const std::string & seqId)
+	{
+		if (currentPath.size() > 0)
+		{
+			if (pending_.size() >= MAX_PENDING)
+			{
+				group_.wait();
+			}
+
+			pending_.push_back(PendingPathPtr(new PendingPath()));
+			PendingPath * path = pending_.back().get();
+			path->name = seqId;
+			path->path.swap(currentPath);
+			path->ready = false;
+			group_.run([path]()
+			{
+				TwoPaCo::CompactPath::EncodeRecord(path->name, path->path, path->record);
+				std::vector<int64_t>().swap(path->path);
+				path->ready = true;
+			});
+
+			Flush();
+		}
+	}
+
+	void Close()
+	{
+		group_.wait();
+		Flush();
+		uint64_t count = offset_.size();
+		out_.write(reinterpret_cast<const char*>(offset_.data()), sizeof(offset_[0]) * count);
+		out_.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		out_.close();
+		if (!out_)
+		{
+			throw std::runtime_error("Can't write to the path file");
+		}
+	}
+
+private:
+	static const size_t MAX_PENDING = 64;
+
+	struct PendingPath
+	{
+		std::string name;
+		std::string record;
+		std::vector<int64_t> path;
+		std::atomic<bool> ready;
+	};
+
+	typedef std::unique_ptr<PendingPath> PendingPathPtr;
+
+	void Flush()
+	{
+		while (pending_.size() > 0 && pending_.front()->ready)
+		{
+			const std::string & record = pending_.front()->record;
+			offset_.push_back(written_);
+			out_.write(record.data(), record.size());
+			written_ += record.size();
+			pending_.pop_front();
+		}
+	}
+
+	uint64_t written_;
+	std::ofstream out_;
+	tbb::task_group group_;
+	std::vector<uint64_t> offset_;
+	std::deque<PendingPathPtr> pending_;
 };
 
 template<class G>
-void GenerateGfaOutput(const std::string & inputFileName, const std::vector<std::string> & genomes, size_t k, bool prefix, G g)
-{	
+void FlushPath(G & g, CompactPathWriter * pathWriter, std::vector<int64_t> & currentPath, const std::string & seqId, size_t k)
+{
+	if (pathWriter != 0)
+	{
+		pathWriter->Add(currentPath, seqId);
+	}
+	else
+	{
+		g.FlushPath(currentPath, seqId, k, std::cout);
+	}
+}
+
+template<class G>
+void GenerateGfaOutput(const std::string & inputFileName, const std::vector<std::string> & genomes, size_t k, bool prefix, LinkMode linkMode, CompactPathWriter * pathWriter, G & g)
+{
+	struct GfaLink
+	{
+		int64_t prevSegmentId;
+		uint64_t prevSegmentSize;
+		int64_t segmentId;
+		uint64_t segmentSize;
+	};
+
+	LinkSet<GfaLink> link;	
 	std::vector<uint64_t> chrSegmentLength;
 	std::vector<std::string> chrSegmentId;
 	std::map<std::string, std::string> chrFileName;
@@ -384,12 +905,13 @@ void GenerateGfaOutput(const std::string & inputFileName, const std::vector<std:
 	//std::cout << "H\tVN:Z:1.0" << std::endl;
 	g.Header(std::cout);
 
-	ReadInputSequences(genomes, chrSegmentId, chrSegmentLength, chrFileName, !prefix);
+	ReadInputSequences(inputFileName, genomes, chrSegmentId, chrSegmentLength, chrFileName, !prefix);
 	g.ListInputSequences(chrSegmentId, chrFileName, std::cout);
 
 	std::vector<int64_t> currentPath;
 	const int64_t NO_SEGMENT = 0;
 	std::string chr;	
+	std::string body;
 	int64_t seqId = NO_SEGMENT;
 	int64_t prevSegmentId = NO_SEGMENT;
 	int64_t prevSegmentSize = -1;
@@ -417,19 +939,16 @@ void GenerateGfaOutput(const std::string & inputFileName, const std::vector<std:
 				if (!seen[Abs(segmentId)])
 				{
 					//std::cout << "S\t" << Abs(segmentId) << "\t";
-					std::stringstream ss;					
 					if (segmentId > 0)
 					{
-						std::copy(chr.begin() + begin.GetPos(), chr.begin() + end.GetPos() + k, std::ostream_iterator<char>(ss));
-
+						body.assign(chr.begin() + begin.GetPos(), chr.begin() + end.GetPos() + k);
 					}
 					else
 					{
-						std::string buf = TwoPaCo::DnaChar::ReverseCompliment(std::string(chr.begin() + begin.GetPos(), chr.begin() + end.GetPos() + k));
-						std::copy(buf.begin(), buf.end(), std::ostream_iterator<char>(ss));
+						TwoPaCo::DnaChar::ReverseCompliment(chr.data() + begin.GetPos(), chr.data() + end.GetPos() + k, body);
 					}
 
-					g.Segment(segmentId, segmentSize, ss.str(), std::cout);
+					g.Segment(segmentId, segmentSize, body, std::cout);
 					seen[Abs(segmentId)] = true;
 				}
 
@@ -452,7 +971,11 @@ void GenerateGfaOutput(const std::string & inputFileName, const std::vector<std:
 				if (prevSegmentId != NO_SEGMENT)
 				{
 					//std::cout << "L\t" << Abs(prevSegmentId) << '\t' << Sign(prevSegmentId) << '\t' << Abs(segmentId) << '\t' << Sign(segmentId) << '\t' << k << 'M' << std::endl;
-					g.Edge(prevSegmentId, prevSegmentSize, segmentId, segmentSize, k, std::cout);
+					GfaLink nowLink = { prevSegmentId, uint64_t(prevSegmentSize), segmentId, segmentSize };
+					if (linkMode == ALL_LINKS || (link.Add(prevSegmentId, segmentId, nowLink) && linkMode == UNIQUE_LINKS))
+					{
+						g.Edge(prevSegmentId, prevSegmentSize, segmentId, segmentSize, k, 0, std::cout);
+					}
 				}				
 
 				prevSegmentId = segmentId;
@@ -461,7 +984,7 @@ void GenerateGfaOutput(const std::string & inputFileName, const std::vector<std:
 			}
 			else
 			{
-				g.FlushPath(currentPath, chrSegmentId[seqId], k, std::cout);
+				FlushPath(g, pathWriter, currentPath, chrSegmentId[seqId], k);
 				chrReader.NextChr(chr);
 				prevSegmentId = 0;
 				begin = end;
@@ -474,7 +997,301 @@ void GenerateGfaOutput(const std::string & inputFileName, const std::vector<std:
 		}
 	}
 
-	g.FlushPath(currentPath, chrSegmentId[seqId], k, std::cout);
+	FlushPath(g, pathWriter, currentPath, chrSegmentId[seqId], k);
+	if (pathWriter != 0)
+	{
+		pathWriter->Close();
+	}
+
+	if (linkMode == COUNTED_LINKS)
+	{
+		for (size_t i = 0; i < link.Size(); i++)
+		{
+			const GfaLink & nowLink = link.Payload(i);
+			g.Edge(nowLink.prevSegmentId, nowLink.prevSegmentSize, nowLink.segmentId, nowLink.segmentSize, k, link.Multiplicity(i), std::cout);
+		}
+	}
+
+	g.Footer(std::cout);
+}
+
+struct Region
+{
+	std::string chr;
+	uint64_t start;
+	uint64_t end;
+};
+
+Region ParseRegion(const std::string & region)
+{
+	Region ret;
+	size_t colon = region.rfind(':');
+	size_t dash = colon == std::string::npos ? std::string::npos : region.find('-', colon);
+	if (colon == std::string::npos || dash == std::string::npos)
+	{
+		throw std::runtime_error("The region should be of form chr:start-end");
+	}
+
+	ret.chr = region.substr(0, colon);
+	std::stringstream startSs(region.substr(colon + 1, dash - colon - 1));
+	std::stringstream endSs(region.substr(dash + 1));
+	if (!(startSs >> ret.start) || !(endSs >> ret.end) || ret.start >= ret.end)
+	{
+		throw std::runtime_error("The region should be of form chr:start-end");
+	}
+
+	return ret;
+}
+
+//Junction pair bounding one occurrence of a segment. The key identifies the pair
+//regardless of the strand, the sign tells whether the occurrence has the strand of the key.
+struct SegmentOccurrence
+{
+	TwoPaCo::JunctionPosition begin;
+	TwoPaCo::JunctionPosition end;
+
+	LinkKey Key() const
+	{
+		LinkKey key = { begin.GetId(), end.GetId() };
+		LinkKey reverse = { -end.GetId(), -begin.GetId() };
+		return std::make_pair(reverse.from, reverse.to) < std::make_pair(key.from, key.to) ? reverse : key;
+	}
+
+	int64_t Sign() const
+	{
+		return Key().from == begin.GetId() && Key().to == end.GetId() ? 1 : -1;
+	}
+};
+
+template<class G>
+void GenerateRegionOutput(const std::string & inputFileName, const std::vector<std::string> & genomes, size_t k, bool prefix, const std::string & regionString, size_t hops, const std::string & tmpDirName, uint64_t memoryLimit, LinkMode linkMode, CompactPathWriter * pathWriter, G & g)
+{
+	Region region = ParseRegion(regionString);
+	TwoPaCo::SequenceManifest manifest;
+	std::vector<uint64_t> chrSegmentLength;
+	std::vector<std::string> chrSegmentId;
+	std::map<std::string, std::string> chrFileName;
+	ReadInputSequences(inputFileName, genomes, manifest, chrSegmentId, chrSegmentLength, chrFileName, !prefix);
+	size_t seqId = std::find(chrSegmentId.begin(), chrSegmentId.end(), region.chr) - chrSegmentId.begin();
+	if (seqId == chrSegmentId.size())
+	{
+		throw std::runtime_error("Can't find the sequence " + region.chr);
+	}
+
+	g.Header(std::cout);
+	g.ListInputSequences(std::vector<std::string>(1, chrSegmentId[seqId]), chrFileName, std::cout);
+
+	//Occurrences of segments overlapping the region and the offsets of their first
+	//junctions. The manifest tells where the junctions of the sequence start, otherwise
+	//the preceding sequences have to be skipped.
+	std::vector<SegmentOccurrence> occurrence;
+	std::unordered_set<uint64_t> occurrenceOffset;
+	{
+		TwoPaCo::JunctionPosition end;
+		TwoPaCo::JunctionPosition begin;
+		TwoPaCo::JunctionPositionReader reader(inputFileName.c_str());
+		if (manifest[seqId].junctionsOffset != UINT64_MAX)
+		{
+			reader.Seek(seqId, manifest[seqId].junctionsOffset);
+		}
+
+		uint64_t beginOffset = 0;
+		while (reader.NextJunctionPosition(end) && end.GetChr() <= seqId)
+		{
+			if (end.GetChr() == seqId && begin.GetChr() == seqId)
+			{
+				if (begin.GetPos() >= region.end)
+				{
+					break;
+				}
+
+				if (end.GetPos() + k > region.start)
+				{
+					SegmentOccurrence now = { begin, end };
+					occurrence.push_back(now);
+					occurrenceOffset.insert(beginOffset);
+				}
+			}
+
+			begin = end;
+			beginOffset = reader.GetOffset();
+		}
+	}
+
+	std::unordered_map<int64_t, uint64_t> segmentSize;
+	std::unordered_map<LinkKey, int64_t, LinkKeyHash> pairSegment;
+	LinkSet<std::pair<int64_t, int64_t> > link;
+	std::vector<int64_t> currentPath;
+	//A link is written at every occurrence as in the whole graph, unless only the
+	//distinct ones are asked for
+	auto addLink = [&](int64_t prevSegmentId, int64_t segmentId)
+	{
+		if (linkMode == ALL_LINKS || (link.Add(prevSegmentId, segmentId, std::make_pair(prevSegmentId, segmentId)) && linkMode == UNIQUE_LINKS))
+		{
+			g.Edge(prevSegmentId, segmentSize[Abs(prevSegmentId)], segmentId, segmentSize[Abs(segmentId)], k, 0, std::cout);
+		}
+	};
+
+	if (occurrence.size() > 0)
+	{
+		//Only the window covered by the segments is read from the input
+		std::string window;
+		uint64_t windowStart = occurrence.front().begin.GetPos();
+		manifest.ReadSequence(seqId, windowStart, occurrence.back().end.GetPos() + k - windowStart, window);
+		for (const SegmentOccurrence & now : occurrence)
+		{
+			uint64_t begin = now.begin.GetPos() - windowStart;
+			uint64_t end = now.end.GetPos() - windowStart;
+			Segment nowSegment(now.begin, now.end, window[begin + k], TwoPaCo::DnaChar::ReverseChar(window[end - 1]));
+			int64_t segmentId = nowSegment.GetSegmentId();
+			uint64_t size = end + k - begin;
+			if (segmentSize.insert(std::make_pair(Abs(segmentId), size)).second)
+			{
+				std::string body(window.begin() + begin, window.begin() + end + k);
+				g.Segment(segmentId, size, segmentId > 0 ? body : TwoPaCo::DnaChar::ReverseCompliment(body), std::cout);
+			}
+
+			g.Occurrence(segmentId, size, chrSegmentId[seqId], chrSegmentLength[seqId], now.begin.GetPos(), now.end.GetPos(), k, std::cout);
+			if (currentPath.size() > 0)
+			{
+				addLink(currentPath.back(), segmentId);
+			}
+
+			currentPath.push_back(segmentId);
+			pairSegment.insert(std::make_pair(now.Key(), segmentId * now.Sign()));
+		}
+	}
+
+	if (hops > 0 && occurrence.size() > 0)
+	{
+		//Each hop adds the neighbours of the junctions selected by the previous one, they are
+		//found by the index of the junctions file. The neighbourhood consists of segments
+		//between two selected junctions.
+		bool temporaryIndex;
+		std::string indexFileName = TwoPaCo::JunctionIndex::Open(inputFileName, tmpDirName, memoryLimit, temporaryIndex);
+		TwoPaCo::JunctionIndex index(indexFileName);
+		TwoPaCo::JunctionPositionReader reader(inputFileName.c_str());
+		const uint64_t RECORD_BYTES = TwoPaCo::JunctionPositionReader::RECORD_BYTES;
+		std::unordered_set<int64_t> selected;
+		for (const SegmentOccurrence & now : occurrence)
+		{
+			selected.insert(Abs(now.begin.GetId()));
+			selected.insert(Abs(now.end.GetId()));
+		}
+
+		TwoPaCo::JunctionPosition pos;
+		std::vector<TwoPaCo::JunctionIndex::Occurrence> found;
+		std::vector<int64_t> frontier(selected.begin(), selected.end());
+		for (size_t hop = 0; hop < hops; hop++)
+		{
+			std::vector<int64_t> next;
+			for (int64_t id : frontier)
+			{
+				index.Find(id, found);
+				for (const TwoPaCo::JunctionIndex::Occurrence & now : found)
+				{
+					if (now.offset >= RECORD_BYTES && reader.ReadAt(now.chr, now.offset - RECORD_BYTES, pos) && selected.insert(Abs(pos.GetId())).second)
+					{
+						next.push_back(Abs(pos.GetId()));
+					}
+
+					if (reader.ReadAt(now.chr, now.offset + RECORD_BYTES, pos) && selected.insert(Abs(pos.GetId())).second)
+					{
+						next.push_back(Abs(pos.GetId()));
+					}
+				}
+			}
+
+			frontier.swap(next);
+		}
+
+		//A segment is found from its first junction, the segments are then taken in the
+		//order of the file
+		std::vector<TwoPaCo::JunctionIndex::Occurrence> segmentStart;
+		for (int64_t id : selected)
+		{
+			index.Find(id, found);
+			for (const TwoPaCo::JunctionIndex::Occurrence & now : found)
+			{
+				if (reader.ReadAt(now.chr, now.offset + RECORD_BYTES, pos) && selected.count(Abs(pos.GetId())) > 0)
+				{
+					segmentStart.push_back(now);
+				}
+			}
+		}
+
+		std::sort(segmentStart.begin(), segmentStart.end(), [](const TwoPaCo::JunctionIndex::Occurrence & a, const TwoPaCo::JunctionIndex::Occurrence & b)
+		{
+			return a.offset < b.offset;
+		});
+
+		if (temporaryIndex)
+		{
+			std::remove(indexFileName.c_str());
+		}
+
+		//Segments are identified by their junctions and read from the first occurrence,
+		//so parallel segments between the same pair of junctions collapse into one
+		std::vector<SegmentOccurrence> neighbour;
+		std::vector<std::pair<SegmentOccurrence, SegmentOccurrence> > neighbourLink;
+		for (size_t i = 0; i < segmentStart.size(); i++)
+		{
+			SegmentOccurrence now;
+			reader.ReadAt(segmentStart[i].chr, segmentStart[i].offset, now.begin);
+			reader.ReadAt(segmentStart[i].chr, segmentStart[i].offset + RECORD_BYTES, now.end);
+			if (pairSegment.insert(std::make_pair(now.Key(), int64_t(0))).second)
+			{
+				neighbour.push_back(now);
+			}
+
+			//The links between the segments of the region are already written
+			if (i > 0 && segmentStart[i - 1].offset + RECORD_BYTES == segmentStart[i].offset &&
+				(occurrenceOffset.count(segmentStart[i - 1].offset) == 0 || occurrenceOffset.count(segmentStart[i].offset) == 0))
+			{
+				SegmentOccurrence prev;
+				reader.ReadAt(segmentStart[i - 1].chr, segmentStart[i - 1].offset, prev.begin);
+				prev.end = now.begin;
+				neighbourLink.push_back(std::make_pair(prev, now));
+			}
+		}
+
+		std::string body;
+		for (const SegmentOccurrence & now : neighbour)
+		{
+			manifest.ReadSequence(now.begin.GetChr(), now.begin.GetPos(), now.end.GetPos() + k - now.begin.GetPos(), body);
+			Segment nowSegment(now.begin, now.end, body[k], TwoPaCo::DnaChar::ReverseChar(body[body.size() - k - 1]));
+			int64_t segmentId = nowSegment.GetSegmentId();
+			pairSegment[now.Key()] = segmentId * now.Sign();
+			if (segmentSize.insert(std::make_pair(Abs(segmentId), body.size())).second)
+			{
+				g.Segment(segmentId, body.size(), segmentId > 0 ? body : TwoPaCo::DnaChar::ReverseCompliment(body), std::cout);
+			}
+		}
+
+		for (const auto & now : neighbourLink)
+		{
+			int64_t prevSegmentId = pairSegment[now.first.Key()] * now.first.Sign();
+			int64_t segmentId = pairSegment[now.second.Key()] * now.second.Sign();
+			addLink(prevSegmentId, segmentId);
+		}
+	}
+
+	if (linkMode == COUNTED_LINKS)
+	{
+		for (size_t i = 0; i < link.Size(); i++)
+		{
+			const std::pair<int64_t, int64_t> & now = link.Payload(i);
+			g.Edge(now.first, segmentSize[Abs(now.first)], now.second, segmentSize[Abs(now.second)], k, link.Multiplicity(i), std::cout);
+		}
+	}
+
+	FlushPath(g, pathWriter, currentPath, regionString, k);
+	if (pathWriter != 0)
+	{
+		pathWriter->Close();
+	}
+
+	g.Footer(std::cout);
 }
 
 template<class It>
@@ -503,11 +1320,12 @@ void GenerateFastaOutput(const std::string & inputFileName, const std::vector<st
 	std::map<std::string, std::string> chrFileName;
 
 
-	ReadInputSequences(genomes, chrSegmentId, chrSegmentLength, chrFileName, false);	
+	ReadInputSequences(inputFileName, genomes, chrSegmentId, chrSegmentLength, chrFileName, false);	
 
 	std::vector<int64_t> currentPath;
 	const int64_t NO_SEGMENT = 0;
 	std::string chr;
+	std::string body;
 	int64_t seqId = NO_SEGMENT;
 	int64_t prevSegmentId = NO_SEGMENT;
 	int64_t prevSegmentSize = -1;
@@ -541,8 +1359,8 @@ void GenerateFastaOutput(const std::string & inputFileName, const std::vector<st
 					}
 					else
 					{
-						std::string buf = TwoPaCo::DnaChar::ReverseCompliment(std::string(chr.begin() + begin.GetPos(), chr.begin() + end.GetPos() + k));
-						OutFastaBody(buf.begin(), buf.end());
+						TwoPaCo::DnaChar::ReverseCompliment(chr.data() + begin.GetPos(), chr.data() + end.GetPos() + k, body);
+						OutFastaBody(body.begin(), body.end());
 					}
 					
 					
@@ -582,26 +1400,50 @@ void GenerateFastaOutput(const std::string & inputFileName, const std::vector<st
 }
 
 
-void GenerateDotOutput(const std::string & inputFileName)
+void DotEdge(const TwoPaCo::JunctionPosition & prevPos, int64_t id, uint64_t multiplicity)
+{
+	std::stringstream label;
+	label << "chr=" << prevPos.GetChr() << " pos=" << prevPos.GetPos();
+	if (multiplicity > 0)
+	{
+		label << " count=" << multiplicity;
+	}
+
+	std::cout << '\t' << prevPos.GetId() << " -> " << id <<
+		"[color=\"blue\", label=\"" << label.str() << "\"]" << std::endl;
+	std::cout << '\t' << -id << " -> " << -prevPos.GetId() <<
+		"[color=\"red\", label=\"" << label.str() << "\"]" << std::endl;
+}
+
+void GenerateDotOutput(const std::string & inputFileName, LinkMode linkMode)
 {
 	TwoPaCo::JunctionPosition pos;
 	TwoPaCo::JunctionPosition prevPos;
 	TwoPaCo::JunctionPositionReader reader(inputFileName.c_str());
+	LinkSet<std::pair<TwoPaCo::JunctionPosition, int64_t> > link;
 	std::cout << "digraph G\n{\n\trankdir = LR" << std::endl;
 	
 	while (reader.NextJunctionPosition(pos))
 	{
 		if (pos.GetChr() == prevPos.GetChr())
 		{
-			std::cout << '\t' << prevPos.GetId() << " -> " << pos.GetId() <<
-				"[color=\"blue\", label=\"chr=" << prevPos.GetChr() << " pos=" << prevPos.GetPos() << "\"]" << std::endl;	
-			std::cout << '\t' << -pos.GetId() << " -> " << -prevPos.GetId() <<
-				"[color=\"red\", label=\"chr=" << prevPos.GetChr() << " pos=" << prevPos.GetPos() << "\"]" << std::endl;
+			if (linkMode == ALL_LINKS || (link.Add(prevPos.GetId(), pos.GetId(), std::make_pair(prevPos, pos.GetId())) && linkMode == UNIQUE_LINKS))
+			{
+				DotEdge(prevPos, pos.GetId(), 0);
+			}
 		}
 
 		prevPos = pos;
 	}
 
+	if (linkMode == COUNTED_LINKS)
+	{
+		for (size_t i = 0; i < link.Size(); i++)
+		{
+			DotEdge(link.Payload(i).first, link.Payload(i).second, link.Multiplicity(i));
+		}
+	}
+
 	std::cout << "}" << std::endl;
 }
 
@@ -614,12 +1456,15 @@ int main(int argc, char * argv[])
 	format.push_back("gfa1");
 	format.push_back("gfa2");
 	format.push_back("fasta");
+	format.push_back("bin");
 	std::stringstream formatString;
 	std::copy(format.begin(), format.begin(), std::ostream_iterator<std::string>(formatString, "|"));
 	try
 	{
 		TCLAP::CmdLine cmd("This utility converts the binary output of TwoPaCo to another format", ' ', "0.9.2");
 		TCLAP::SwitchArg prefix("", "prefix", "Add a prefix to segments in GFA (in case if you have genomes with identical FASTA headers)", cmd, false);
+		TCLAP::SwitchArg uniqueLinks("", "unique", "Output each distinct link (GFA) or edge (DOT) only once", cmd, false);
+		TCLAP::SwitchArg countLinks("", "count", "Output each distinct link (GFA) or edge (DOT) once with the number of its occurrences", cmd, false);
 
 		TCLAP::UnlabeledValueArg<std::string> inputFileName("infile",
 			"input file name",
@@ -652,18 +1497,119 @@ int main(int argc, char * argv[])
 			"integer",
 			cmd);
 
+		TCLAP::ValueArg<std::string> tmpDirName("",
+			"tmpdir",
+			"Temporary directory name",
+			false,
+			".",
+			"directory name",
+			cmd);
+
+		TCLAP::ValueArg<std::string> pathFileName("",
+			"pathfile",
+			"Write paths of GFA output to this file in a compact binary form instead of P/O records",
+			false,
+			"",
+			"file name",
+			cmd);
+
+		TCLAP::ValueArg<std::string> region("",
+			"region",
+			"Output only the part of the graph (gfa1, gfa2, bin) covering the region chr:start-end of an input sequence",
+			false,
+			"",
+			"region",
+			cmd);
+
+		TCLAP::ValueArg<unsigned int> hops("",
+			"hops",
+			"With --region, also output the neighbourhood of the region up to this number of hops. The first use builds the index <input file>.index",
+			false,
+			0,
+			"integer",
+			cmd);
+
+		TCLAP::ValueArg<uint64_t> memoryLimit("",
+			"memory",
+			"Memory limit for external sorting in the group and bin modes and for building the index of --hops, in megabytes",
+			false,
+			1024,
+			"integer",
+			cmd);
+
 		cmd.parse(argc, argv);
-		if (outputFileFormat.getValue() == format[0])
+		//The seq, group and fasta formats have no links to deduplicate or count
+		if ((uniqueLinks.getValue() || countLinks.getValue()) &&
+			(outputFileFormat.getValue() == format[0] || outputFileFormat.getValue() == format[1] || outputFileFormat.getValue() == format[5]))
+		{
+			throw TCLAP::ArgParseException("The links can only be deduplicated or counted with the dot, gfa1, gfa2 or bin format\n", uniqueLinks.getValue() ? "unique" : "count");
+		}
+
+		LinkMode linkMode = ALL_LINKS;
+		if (countLinks.getValue())
+		{
+			linkMode = COUNTED_LINKS;
+		}
+		else if (uniqueLinks.getValue())
+		{
+			linkMode = UNIQUE_LINKS;
+		}
+
+		std::unique_ptr<CompactPathWriter> pathWriter;
+		if (pathFileName.isSet())
+		{
+			//Only the GFA generators produce paths, any other format would leave an unreadable file
+			if (outputFileFormat.getValue() != format[3] && outputFileFormat.getValue() != format[4])
+			{
+				throw TCLAP::ArgParseException("The paths can only be written with the gfa1 or gfa2 format\n", "pathfile");
+			}
+
+			pathWriter.reset(new CompactPathWriter(pathFileName.getValue()));
+		}
+
+		if (hops.isSet() && !region.isSet())
+		{
+			throw TCLAP::ArgParseException("The neighbourhood can only be output with --region\n", "hops");
+		}
+
+		if (region.isSet())
+		{
+			if (!seqFileName.isSet())
+			{
+				throw TCLAP::ArgParseException("Required argument missing\n", "seqfilename");
+			}
+
+			if (outputFileFormat.getValue() == format[3])
+			{
+				Gfa1Generator generator;
+				GenerateRegionOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), region.getValue(), hops.getValue(), tmpDirName.getValue(), memoryLimit.getValue() << 20, linkMode, pathWriter.get(), generator);
+			}
+			else if (outputFileFormat.getValue() == format[4])
+			{
+				Gfa2Generator generator;
+				GenerateRegionOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), region.getValue(), hops.getValue(), tmpDirName.getValue(), memoryLimit.getValue() << 20, linkMode, pathWriter.get(), generator);
+			}
+			else if (outputFileFormat.getValue() == format[6])
+			{
+				BinaryGraphGenerator generator(kvalue.getValue(), tmpDirName.getValue(), memoryLimit.getValue() << 20);
+				GenerateRegionOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), region.getValue(), hops.getValue(), tmpDirName.getValue(), memoryLimit.getValue() << 20, linkMode, 0, generator);
+			}
+			else
+			{
+				throw std::runtime_error("The region can only be output in gfa1, gfa2 or bin format");
+			}
+		}
+		else if (outputFileFormat.getValue() == format[0])
 		{
 			GenerateOrdinaryOutput(inputFileName.getValue());
 		}
 		else if (outputFileFormat.getValue() == format[1])
 		{
-			GenerateGroupOutupt(inputFileName.getValue());
+			GenerateGroupOutupt(inputFileName.getValue(), tmpDirName.getValue(), memoryLimit.getValue() << 20);
 		}
 		else if (outputFileFormat.getValue() == format[2])
 		{
-			GenerateDotOutput(inputFileName.getValue());
+			GenerateDotOutput(inputFileName.getValue(), linkMode);
 		}
 		else if (outputFileFormat.getValue() == format[3])
 		{
@@ -672,7 +1618,8 @@ int main(int argc, char * argv[])
 				throw TCLAP::ArgParseException("Required argument missing\n", "seqfilename");
 			}
 
-			GenerateGfaOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), Gfa1Generator());
+			Gfa1Generator generator;
+			GenerateGfaOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), linkMode, pathWriter.get(), generator);
 		}
 		else if (outputFileFormat.getValue() == format[4])
 		{
@@ -681,7 +1628,8 @@ int main(int argc, char * argv[])
 				throw TCLAP::ArgParseException("Required argument missing\n", "seqfilename");
 			}
 
-			GenerateGfaOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), Gfa2Generator());
+			Gfa2Generator generator;
+			GenerateGfaOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), linkMode, pathWriter.get(), generator);
 		}
 		else if (outputFileFormat.getValue() == format[5])
 		{
@@ -692,6 +1640,16 @@ int main(int argc, char * argv[])
 
 			GenerateFastaOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue());
 		}
+		else if (outputFileFormat.getValue() == format[6])
+		{
+			if (!seqFileName.isSet())
+			{
+				throw TCLAP::ArgParseException("Required argument missing\n", "seqfilename");
+			}
+
+			BinaryGraphGenerator generator(kvalue.getValue(), tmpDirName.getValue(), memoryLimit.getValue() << 20);
+			GenerateGfaOutput(inputFileName.getValue(), seqFileName.getValue(), kvalue.getValue(), prefix.getValue(), linkMode, 0, generator);
+		}
 	}
 	catch (TCLAP::ArgException &e)
 	{
@@ -0,0 +1,169 @@
+#ifndef _JUNCTION_INDEX_H_
+#define _JUNCTION_INDEX_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <junctionapi/junctionapi.h>
+
+#include "externalsort.h"
+
+namespace TwoPaCo
+{
+	//Occurrences of every junction id in the junctions file, so the neighbours of a
+	//junction are read with a few seeks instead of a pass over the file. The index is a
+	//sidecar of the junctions file built once by an external sort: a header with the
+	//largest id plus one and the offset of the table, the occurrences sorted by the
+	//absolute value of the id and the table with the number of the first occurrence of
+	//every id, followed by the total number of occurrences
+	class JunctionIndex
+	{
+	public:
+		struct Occurrence
+		{
+			//Byte offset of the junction in the junctions file
+			uint64_t offset;
+			uint32_t chr;
+			uint32_t reserved;
+		};
+
+		static std::string DefaultFileName(const std::string & junctionsFileName)
+		{
+			return junctionsFileName + ".index";
+		}
+
+		//Returns the name of an index of the junctions file that is not older than it,
+		//building it if needed. If the sidecar can't be written, the index goes to the
+		//temporary directory and isTemporary is set
+		static std::string Open(const std::string & junctionsFileName, const std::string & tmpDirName, uint64_t memoryLimit, bool & isTemporary)
+		{
+			struct stat junctionsStat;
+			struct stat indexStat;
+			std::string indexFileName = DefaultFileName(junctionsFileName);
+			isTemporary = false;
+			if (stat(junctionsFileName.c_str(), &junctionsStat) == 0 && stat(indexFileName.c_str(), &indexStat) == 0 &&
+				std::make_pair(indexStat.st_mtim.tv_sec, indexStat.st_mtim.tv_nsec) >= std::make_pair(junctionsStat.st_mtim.tv_sec, junctionsStat.st_mtim.tv_nsec))
+			{
+				return indexFileName;
+			}
+
+			if (!std::ofstream(indexFileName.c_str(), std::ios::binary))
+			{
+				std::stringstream ss;
+				ss << tmpDirName << "/junctions_" << getpid() << ".index";
+				indexFileName = ss.str();
+				isTemporary = true;
+			}
+
+			Build(junctionsFileName, indexFileName, tmpDirName, memoryLimit);
+			return indexFileName;
+		}
+
+		static void Build(const std::string & junctionsFileName, const std::string & indexFileName, const std::string & tmpDirName, uint64_t memoryLimit)
+		{
+			ExternalSorter<Entry, bool(*)(const Entry &, const Entry &)> sorter(tmpDirName + "/junction_index", memoryLimit, CompareEntries);
+			{
+				JunctionPosition pos;
+				JunctionPositionReader reader(junctionsFileName);
+				while (reader.NextJunctionPosition(pos))
+				{
+					Entry entry = { uint64_t(std::llabs(pos.GetId())), { reader.GetOffset(), pos.GetChr(), 0 } };
+					sorter.Push(entry);
+				}
+			}
+
+			sorter.Sort();
+			std::string tableFileName = indexFileName + ".table";
+			std::ofstream out(indexFileName.c_str(), std::ios::binary);
+			std::ofstream table(tableFileName.c_str(), std::ios::binary);
+			uint64_t header[] = { 0, 0 };
+			out.write(reinterpret_cast<const char*>(header), sizeof(header));
+			Entry entry;
+			uint64_t count = 0;
+			uint64_t nextId = 0;
+			while (sorter.Next(entry))
+			{
+				for (; nextId <= entry.id; nextId++)
+				{
+					table.write(reinterpret_cast<const char*>(&count), sizeof(count));
+				}
+
+				out.write(reinterpret_cast<const char*>(&entry.occurrence), sizeof(entry.occurrence));
+				count++;
+			}
+
+			table.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			table.close();
+			header[0] = nextId;
+			header[1] = sizeof(header) + count * sizeof(Occurrence);
+			std::ifstream tableIn(tableFileName.c_str(), std::ios::binary);
+			out << tableIn.rdbuf();
+			tableIn.close();
+			std::remove(tableFileName.c_str());
+			out.seekp(0);
+			out.write(reinterpret_cast<const char*>(header), sizeof(header));
+			if (!out)
+			{
+				throw std::runtime_error("Can't write the junction index");
+			}
+		}
+
+		JunctionIndex(const std::string & indexFileName) : in_(indexFileName.c_str(), std::ios::binary)
+		{
+			in_.read(reinterpret_cast<char*>(&idBound_), sizeof(idBound_));
+			in_.read(reinterpret_cast<char*>(&tableOffset_), sizeof(tableOffset_));
+			if (!in_)
+			{
+				throw std::runtime_error("Can't read the junction index");
+			}
+		}
+
+		//The occurrences of the id in any orientation in the order of the file
+		void Find(int64_t id, std::vector<Occurrence> & occurrence)
+		{
+			occurrence.clear();
+			uint64_t absId = std::llabs(id);
+			if (absId < idBound_)
+			{
+				uint64_t range[2];
+				in_.clear();
+				in_.seekg(tableOffset_ + absId * sizeof(uint64_t));
+				in_.read(reinterpret_cast<char*>(range), sizeof(range));
+				occurrence.resize(range[1] - range[0]);
+				in_.seekg(sizeof(uint64_t) * 2 + range[0] * sizeof(Occurrence));
+				in_.read(reinterpret_cast<char*>(occurrence.data()), occurrence.size() * sizeof(Occurrence));
+				if (!in_)
+				{
+					throw std::runtime_error("Can't read the junction index");
+				}
+			}
+		}
+
+	private:
+		struct Entry
+		{
+			uint64_t id;
+			Occurrence occurrence;
+		};
+
+		static bool CompareEntries(const Entry & a, const Entry & b)
+		{
+			return a.id < b.id || (a.id == b.id && a.occurrence.offset < b.occurrence.offset);
+		}
+
+		uint64_t idBound_;
+		uint64_t tableOffset_;
+		std::ifstream in_;
+	};
+}
+
+#endif